@@ -0,0 +1,83 @@
+#pragma once
+#include <glad/glad.h>
+#include <cstdint>
+#include <vector>
+
+// Copies ranges of GPU buffers into a persistently mapped staging buffer and fences the copy. The CPU reads the
+// data once the fence has signaled, instead of stalling in glGetBufferSubData until the GPU caught up. The data
+// stays valid until the next request.
+class BufferReadback {
+public:
+	struct Range {
+		GLuint buffer;
+		GLintptr offset;
+		GLsizeiptr size;
+	};
+
+	explicit BufferReadback(GLsizeiptr _capacity) : capacity(_capacity) {
+        const GLbitfield mapFlags = GL_MAP_READ_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+        glCreateBuffers(1, &stagingBuffer);
+        glNamedBufferStorage(stagingBuffer, capacity, nullptr, mapFlags);
+        data = static_cast<const uint8_t*>(glMapNamedBufferRange(stagingBuffer, 0, capacity, mapFlags));
+    }
+	~BufferReadback() {
+        if (fence)
+            glDeleteSync(fence);
+        glUnmapNamedBuffer(stagingBuffer);
+        glDeleteBuffers(1, &stagingBuffer);
+    }
+	BufferReadback(const BufferReadback&) = delete;
+	BufferReadback& operator=(const BufferReadback&) = delete;
+
+	// Queues the copies, packed in order. Fails when a readback is still pending or the ranges don't fit.
+	bool request(const std::vector<Range>& ranges) {
+        GLsizeiptr totalSize = 0;
+        for (const Range& range : ranges)
+        {
+            totalSize += range.size;
+        }
+        if (fence || totalSize > capacity)
+            return false;
+
+        // Shader storage writes have to land before the copies read the buffers
+        glMemoryBarrier(GL_BUFFER_UPDATE_BARRIER_BIT);
+        offsets.clear();
+        size = 0;
+        for (const Range& range : ranges)
+        {
+            offsets.push_back(size);
+            glCopyNamedBufferSubData(range.buffer, stagingBuffer, range.offset, size, range.size);
+            size += range.size;
+        }
+        fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+        return true;
+    }
+
+	// Returns whether the requested data has arrived, waiting for it blocks until the copies have finished
+	bool poll(bool wait = false) {
+        if (!fence)
+            return size > 0;
+
+        const GLenum status = glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, wait ? GL_TIMEOUT_IGNORED : 0);
+        if (status == GL_TIMEOUT_EXPIRED)
+            return false;
+
+        glDeleteSync(fence);
+        fence = nullptr;
+        return status != GL_WAIT_FAILED;
+    }
+
+	bool isPending() const { return fence != nullptr; }
+	const uint8_t* getData() const { return data; }
+	GLsizeiptr getSize() const { return size; }
+	// Position of the requested ranges in the data
+	const std::vector<GLsizeiptr>& getOffsets() const { return offsets; }
+
+private:
+	GLsizeiptr capacity;
+	GLuint stagingBuffer = GL_NONE;
+	const uint8_t* data = nullptr;
+	GLsync fence = nullptr;
+	GLsizeiptr size = 0;
+	std::vector<GLsizeiptr> offsets;
+};
@@ -1,6 +1,7 @@
 #pragma once
 #include <glm/gtc/matrix_transform.hpp>
 #include <glm/ext/matrix_float4x4.hpp>
+#include <array>
 
 #define FULL_CIRCLE (2 * glm::pi<float>())
 
@@ -20,6 +21,20 @@ public:
     [[nodiscard]] const glm::mat4& getProjection() const {
         return projection;
     }
+    // Planes of the view frustum in world space as (normal, distance), normals point inside
+    [[nodiscard]] std::array<glm::vec4, 6> getFrustumPlanes() const {
+        const glm::mat4 viewProjection = projection * view;
+        const glm::vec4 row0(viewProjection[0][0], viewProjection[1][0], viewProjection[2][0], viewProjection[3][0]);
+        const glm::vec4 row1(viewProjection[0][1], viewProjection[1][1], viewProjection[2][1], viewProjection[3][1]);
+        const glm::vec4 row2(viewProjection[0][2], viewProjection[1][2], viewProjection[2][2], viewProjection[3][2]);
+        const glm::vec4 row3(viewProjection[0][3], viewProjection[1][3], viewProjection[2][3], viewProjection[3][3]);
+        std::array<glm::vec4, 6> planes = { row3 + row0, row3 - row0, row3 + row1, row3 - row1, row3 + row2, row3 - row2 };
+        for (glm::vec4& plane : planes)
+        {
+            plane /= glm::length(glm::vec3(plane));
+        }
+        return planes;
+    }
 
     void setPosition(const glm::vec3& position) {
         this->position = position;
@@ -0,0 +1,62 @@
+#pragma once
+#include <glm/glm.hpp>
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+
+// CPU side of the COMPACT_POSITIONS storage. Follow the leader keeps every segment of a strand at its rest length,
+// so a strand is its root and the direction of every segment. The roots stay full precision floats in model space,
+// and each direction is an octahedral projection packed into two 16-bit snorms, 4 bytes instead of 12 per particle.
+// Particle i of a strand sits at root + the sum of the first i directions times the segment length. The packing
+// matches packSnorm2x16 and unpackSnorm2x16 in the shaders.
+class CompactPositions {
+public:
+	static uint32_t encodeDirection(const glm::vec3& direction) {
+        const float norm = std::max(std::abs(direction.x) + std::abs(direction.y) + std::abs(direction.z), 1e-20f);
+        const glm::vec3 projected = direction / norm;
+        float x = projected.x;
+        float y = projected.y;
+        // The lower hemisphere is folded over the diagonals of the octahedron
+        if (projected.z < 0.f)
+        {
+            x = (1.f - std::abs(projected.y)) * (projected.x >= 0.f ? 1.f : -1.f);
+            y = (1.f - std::abs(projected.x)) * (projected.y >= 0.f ? 1.f : -1.f);
+        }
+        return packSnorm(x) | (packSnorm(y) << 16);
+    }
+	static glm::vec3 decodeDirection(uint32_t encoded) {
+        const float x = unpackSnorm(encoded & 0xFFFF);
+        const float y = unpackSnorm(encoded >> 16);
+        glm::vec3 direction(x, y, 1.f - std::abs(x) - std::abs(y));
+        const float fold = std::max(-direction.z, 0.f);
+        direction.x += direction.x >= 0.f ? -fold : fold;
+        direction.y += direction.y >= 0.f ? -fold : fold;
+        return direction / glm::length(direction);
+    }
+
+	// Splits strands of particlesPerStrand positions into their roots and segment directions. The root stays where
+	// it is and the rest of the strand is expected in the same space, which holds while the hair's transform is the
+	// identity, as when the strands are built. The first direction of every strand is unused and set to zero.
+	static void encodeStrands(const glm::vec3* positions, uint32_t strandCount, uint32_t particlesPerStrand,
+		glm::vec3* roots, uint32_t* directions) {
+        for (uint32_t strand = 0; strand < strandCount; ++strand)
+        {
+            const glm::vec3* strandPositions = positions + static_cast<size_t>(strand) * particlesPerStrand;
+            uint32_t* strandDirections = directions + static_cast<size_t>(strand) * particlesPerStrand;
+            roots[strand] = strandPositions[0];
+            strandDirections[0] = 0;
+            for (uint32_t particle = 1; particle < particlesPerStrand; ++particle)
+            {
+                strandDirections[particle] = encodeDirection(strandPositions[particle] - strandPositions[particle - 1]);
+            }
+        }
+    }
+
+private:
+	static uint32_t packSnorm(float value) {
+        return static_cast<uint32_t>(static_cast<int32_t>(std::round(std::clamp(value, -1.f, 1.f) * 32767.f))) & 0xFFFF;
+    }
+	static float unpackSnorm(uint32_t bits) {
+        return std::clamp(static_cast<float>(static_cast<int16_t>(bits)) / 32767.f, -1.f, 1.f);
+    }
+};
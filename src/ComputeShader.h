@@ -3,11 +3,8 @@
 
 class ComputeShader : public Shader {
 public:
-	explicit ComputeShader(const std::string& shaderFile) {
-        GLuint shaderID = glCreateShader(GL_COMPUTE_SHADER);
-        compileAndAttachShader(shaderFile, shaderID);
-        linkProgram();
-        glDeleteShader(shaderID);
+	explicit ComputeShader(const std::string& shaderFile, const std::vector<std::string>& defines = {}) {
+        buildProgram({ { GL_COMPUTE_SHADER, shaderFile } }, defines);
     }
 	~ComputeShader() override = default;
 	void dispatch() const {
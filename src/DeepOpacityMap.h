@@ -0,0 +1,190 @@
+#pragma once
+#include "DrawingShader.h"
+#include "GpuProfiler.h"
+#include "Hair.h"
+
+const uint32_t DEEP_OPACITY_MAP_RESOLUTION = 512U;
+const glm::vec4 DEEP_OPACITY_LAYER_ENDS{ 0.05f, 0.15f, 0.35f, 0.8f };	// Distance of each layer end behind the first strand
+const float DEEP_OPACITY_STRAND_OPACITY = 0.1f;
+const float DEEP_OPACITY_LIGHT_THRESHOLD = 0.05f;		// Light movement that forces a rebuild
+const float DEEP_OPACITY_HAIR_THRESHOLD = 0.01f;		// Change of any hair transform element that forces a rebuild
+const uint32_t DEEP_OPACITY_UPDATE_INTERVAL = 4U;		// Frames between rebuilds for the simulated motion alone
+const GLuint DEEP_OPACITY_DEPTH_TEXTURE_UNIT = 2;
+const GLuint DEEP_OPACITY_LAYERS_TEXTURE_UNIT = 3;
+
+// Self shadowing with deep opacity maps (Yuksel and Keyser). The hair is rendered twice from the light with the
+// vertex pulling shader: a depth pass finds the first strand per texel, then a layer pass additively accumulates
+// strand opacity into four layers starting at that depth, each channel holding the opacity up to its layer end.
+// Shading interpolates the layers at the fragment's depth behind the first strand.
+class DeepOpacityMap {
+public:
+	// The defines select the position storage of the hair, as for the hair shaders
+	explicit DeepOpacityMap(const std::vector<std::string>& defines = {}, uint32_t _resolution = DEEP_OPACITY_MAP_RESOLUTION)
+    : resolution(_resolution),
+    depthShader("HairStrandVertexShader.glsl", "DeepOpacityFragmentShader.glsl", withDepthPass(defines)),
+    layerShader("HairStrandVertexShader.glsl", "DeepOpacityFragmentShader.glsl", defines) {
+        glCreateTextures(GL_TEXTURE_2D, 1, &depthTexture);
+        glTextureStorage2D(depthTexture, 1, GL_DEPTH_COMPONENT32F, resolution, resolution);
+        glCreateTextures(GL_TEXTURE_2D, 1, &layerTexture);
+        glTextureStorage2D(layerTexture, 1, GL_RGBA16F, resolution, resolution);
+        for (GLuint texture : { depthTexture, layerTexture })
+        {
+            glTextureParameteri(texture, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+            glTextureParameteri(texture, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+            glTextureParameteri(texture, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_BORDER);
+            glTextureParameteri(texture, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_BORDER);
+        }
+        // Outside of the map there is no hair in front: depth at the far plane and no opacity
+        const float farDepth[] = { 1.f, 1.f, 1.f, 1.f };
+        glTextureParameterfv(depthTexture, GL_TEXTURE_BORDER_COLOR, farDepth);
+
+        glCreateFramebuffers(1, &depthFramebuffer);
+        glNamedFramebufferTexture(depthFramebuffer, GL_DEPTH_ATTACHMENT, depthTexture, 0);
+        glNamedFramebufferDrawBuffer(depthFramebuffer, GL_NONE);
+        glCreateFramebuffers(1, &layerFramebuffer);
+        glNamedFramebufferTexture(layerFramebuffer, GL_COLOR_ATTACHMENT0, layerTexture, 0);
+
+        if (glCheckNamedFramebufferStatus(depthFramebuffer, GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE ||
+            glCheckNamedFramebufferStatus(layerFramebuffer, GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+            std::cout << "Deep opacity map framebuffers are incomplete" << std::endl;
+    }
+	~DeepOpacityMap() {
+        glDeleteFramebuffers(1, &depthFramebuffer);
+        glDeleteFramebuffers(1, &layerFramebuffer);
+        glDeleteTextures(1, &depthTexture);
+        glDeleteTextures(1, &layerTexture);
+    }
+	DeepOpacityMap(const DeepOpacityMap&) = delete;
+	DeepOpacityMap& operator=(const DeepOpacityMap&) = delete;
+
+	// Rebuilds the maps when the light or the hair moved beyond the thresholds, or the update interval elapsed.
+	// Returns whether the maps were rebuilt.
+	bool update(const Hair& hair, const glm::vec3& lightPosition);
+
+	// Binds the maps and sets the lookup uniforms of a SELF_SHADOWING hair shader, which has to be in use
+	void apply(const Shader& shader) const {
+        glBindTextureUnit(DEEP_OPACITY_DEPTH_TEXTURE_UNIT, depthTexture);
+        glBindTextureUnit(DEEP_OPACITY_LAYERS_TEXTURE_UNIT, layerTexture);
+        shader.setInt("opacityDepth", DEEP_OPACITY_DEPTH_TEXTURE_UNIT);
+        shader.setInt("opacityLayers", DEEP_OPACITY_LAYERS_TEXTURE_UNIT);
+        shader.setMat4("lightViewProjection", lightViewProjection);
+        shader.setFloat("lightDepthRange", lightDepthRange);
+        shader.setVec4("opacityLayerEnds", DEEP_OPACITY_LAYER_ENDS);
+    }
+
+	void setProfiler(GpuProfiler* _profiler) { profiler = _profiler; }
+	void setUpdateInterval(uint32_t frames) { updateInterval = frames; }
+	uint32_t getResolution() const { return resolution; }
+
+private:
+	static std::vector<std::string> withDepthPass(std::vector<std::string> defines) {
+        defines.push_back("DEPTH_PASS");
+        return defines;
+    }
+
+	void render(const Hair& hair, const glm::vec3& lightPosition);
+
+	uint32_t resolution;
+	DrawingShader depthShader;
+	DrawingShader layerShader;
+	GLuint depthTexture = GL_NONE;
+	GLuint layerTexture = GL_NONE;
+	GLuint depthFramebuffer = GL_NONE;
+	GLuint layerFramebuffer = GL_NONE;
+	glm::mat4 lightViewProjection{ 1.f };
+	float lightDepthRange = 1.f;
+
+	glm::vec3 lastLightPosition{ 0.f };
+	glm::mat4 lastHairTransform{ 0.f };
+	uint32_t framesSinceUpdate = 0;
+	uint32_t updateInterval = DEEP_OPACITY_UPDATE_INTERVAL;
+	bool valid = false;
+	GpuProfiler* profiler = nullptr;
+};
+
+inline bool DeepOpacityMap::update(const Hair& hair, const glm::vec3& lightPosition)
+{
+    ++framesSinceUpdate;
+    bool hairMoved = false;
+    for (int i = 0; i < 4; ++i)
+    {
+        for (int j = 0; j < 4; ++j)
+        {
+            hairMoved |= glm::abs(hair.getTransformMatrix()[i][j] - lastHairTransform[i][j]) > DEEP_OPACITY_HAIR_THRESHOLD;
+        }
+    }
+
+    if (valid && !hairMoved && framesSinceUpdate < updateInterval &&
+        glm::distance(lightPosition, lastLightPosition) <= DEEP_OPACITY_LIGHT_THRESHOLD)
+        return false;
+
+    render(hair, lightPosition);
+    lastLightPosition = lightPosition;
+    lastHairTransform = hair.getTransformMatrix();
+    framesSinceUpdate = 0;
+    valid = true;
+    return true;
+}
+
+inline void DeepOpacityMap::render(const Hair& hair, const glm::vec3& lightPosition)
+{
+    // Orthographic light frustum around a sphere enclosing the head and the hanging strands
+    const glm::vec3 center = glm::vec3(hair.getTransformMatrix()[3]);
+    const float boundsRadius = HAIR_LENGTH + 1.f;
+    const glm::vec3 lightDirection = glm::normalize(center - lightPosition);
+    const glm::vec3 up = glm::abs(lightDirection.y) > 0.99f ? glm::vec3(0.f, 0.f, 1.f) : glm::vec3(0.f, 1.f, 0.f);
+    const float lightDistance = glm::distance(center, lightPosition);
+    const float nearPlane = glm::max(lightDistance - boundsRadius, 0.01f);
+    const float farPlane = lightDistance + boundsRadius;
+    lightViewProjection = glm::ortho(-boundsRadius, boundsRadius, -boundsRadius, boundsRadius, nearPlane, farPlane) *
+        glm::lookAt(lightPosition, center, up);
+    lightDepthRange = farPlane - nearPlane;
+
+    GLint viewport[4];
+    glGetIntegerv(GL_VIEWPORT, viewport);
+    GLint targetFramebuffer = 0;
+    glGetIntegerv(GL_DRAW_FRAMEBUFFER_BINDING, &targetFramebuffer);
+    glViewport(0, 0, resolution, resolution);
+
+    const GLboolean blendEnabled = glIsEnabled(GL_BLEND);
+    const float farDepth = 1.f;
+    const float noOpacity[] = { 0.f, 0.f, 0.f, 0.f };
+
+    if (profiler) profiler->begin("Opacity depth");
+    glBindFramebuffer(GL_FRAMEBUFFER, depthFramebuffer);
+    glClearNamedFramebufferfv(depthFramebuffer, GL_DEPTH, 0, &farDepth);
+    depthShader.use();
+    depthShader.setMat4("projection", lightViewProjection);
+    depthShader.setMat4("view", glm::mat4(1.f));
+    depthShader.setMat4("model", hair.getTransformMatrix());
+    depthShader.setUint("particlesPerStrand", hair.getParticlesPerStrand());
+    hair.drawLines();
+    if (profiler) profiler->end("Opacity depth");
+
+    if (profiler) profiler->begin("Opacity layers");
+    glBindFramebuffer(GL_FRAMEBUFFER, layerFramebuffer);
+    glClearNamedFramebufferfv(layerFramebuffer, GL_COLOR, 0, noOpacity);
+    glDisable(GL_DEPTH_TEST);
+    glEnable(GL_BLEND);
+    glBlendFunc(GL_ONE, GL_ONE);
+    glBindTextureUnit(DEEP_OPACITY_DEPTH_TEXTURE_UNIT, depthTexture);
+    layerShader.use();
+    layerShader.setMat4("projection", lightViewProjection);
+    layerShader.setMat4("view", glm::mat4(1.f));
+    layerShader.setMat4("model", hair.getTransformMatrix());
+    layerShader.setUint("particlesPerStrand", hair.getParticlesPerStrand());
+    layerShader.setInt("opacityDepth", DEEP_OPACITY_DEPTH_TEXTURE_UNIT);
+    layerShader.setFloat("lightDepthRange", lightDepthRange);
+    layerShader.setVec4("opacityLayerEnds", DEEP_OPACITY_LAYER_ENDS);
+    layerShader.setFloat("strandOpacity", DEEP_OPACITY_STRAND_OPACITY);
+    hair.drawLines();
+    if (profiler) profiler->end("Opacity layers");
+
+    // Restore the state the main pass expects
+    glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+    if (!blendEnabled)
+        glDisable(GL_BLEND);
+    glEnable(GL_DEPTH_TEST);
+    glBindFramebuffer(GL_FRAMEBUFFER, targetFramebuffer);
+    glViewport(viewport[0], viewport[1], viewport[2], viewport[3]);
+}
@@ -3,17 +3,13 @@
 
 class DrawingShader : public Shader {
 public:
-	DrawingShader(const std::string& vertexShaderFile, const std::string& geometryShaderFile, const std::string& fragmentShaderFile) {
-        GLuint vertexShaderID = glCreateShader(GL_VERTEX_SHADER);
-        GLuint fragmentShaderID = glCreateShader(GL_FRAGMENT_SHADER);
-        GLuint geometryShaderID = glCreateShader(GL_GEOMETRY_SHADER);
-        compileAndAttachShader(vertexShaderFile, vertexShaderID);
-        compileAndAttachShader(fragmentShaderFile, fragmentShaderID);
-        compileAndAttachShader(geometryShaderFile, geometryShaderID);
-        linkProgram();
-        glDeleteShader(vertexShaderID);
-        glDeleteShader(fragmentShaderID);
-        glDeleteShader(geometryShaderID);
+	DrawingShader(const std::string& vertexShaderFile, const std::string& geometryShaderFile, const std::string& fragmentShaderFile, const std::vector<std::string>& defines = {}) {
+        buildProgram({ { GL_VERTEX_SHADER, vertexShaderFile }, { GL_FRAGMENT_SHADER, fragmentShaderFile }, { GL_GEOMETRY_SHADER, geometryShaderFile } },
+            defines);
+    }
+	// Program without a geometry stage
+	DrawingShader(const std::string& vertexShaderFile, const std::string& fragmentShaderFile, const std::vector<std::string>& defines = {}) {
+        buildProgram({ { GL_VERTEX_SHADER, vertexShaderFile }, { GL_FRAGMENT_SHADER, fragmentShaderFile } }, defines);
     }
 	~DrawingShader() override = default;
 };
\ No newline at end of file
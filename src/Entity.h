@@ -29,10 +29,17 @@ public:
 	void translate(const glm::vec3& translation) {
         translationVector = translation;
         transformMatrix = glm::scale(glm::translate(glm::mat4(1.f), translationVector) * glm::mat4_cast(rotationQuat), scaleVector);
+    }
+	void setRotation(const glm::quat& rotation) {
+        rotationQuat = rotation;
+        transformMatrix = glm::scale(glm::translate(glm::mat4(1.f), translationVector) * glm::mat4_cast(rotationQuat), scaleVector);
     }
 	const glm::mat4& getTransformMatrix() const {
         return transformMatrix;
     }
+	const glm::vec3& getTranslation() const { return translationVector; }
+	const glm::quat& getRotation() const { return rotationQuat; }
+	const glm::vec3& getScale() const { return scaleVector; }
 
 	glm::vec3 color{ 1.f };
 
@@ -0,0 +1,238 @@
+#pragma once
+#include <glad/glad.h>
+#include <glm/vec2.hpp>
+#include "GpuProfiler.h"
+#include <array>
+#include <condition_variable>
+#include <cstdio>
+#include <deque>
+#include <filesystem>
+#include <iomanip>
+#include <iostream>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <thread>
+
+const uint32_t FRAME_CAPTURE_RING_SIZE = 4U;		// Frames in flight between the draw and the disk
+
+// Renders the frame into an offscreen target and writes every frame to numbered TGA files. The resolved frame is
+// read into a ring of persistently mapped pixel buffers, and a fence per buffer tells when the copy finished, so
+// glReadPixels returns immediately instead of waiting for the GPU. A worker thread writes the mapped memory to
+// disk, the GL thread only waits when the whole ring is still in flight.
+class FrameCapture {
+public:
+	FrameCapture(const glm::ivec2& _size, int sampleCount, const std::string& _directory, uint32_t _frameLimit = 0)
+    : size(_size), directory(_directory), frameLimit(_frameLimit) {
+        std::error_code error;
+        std::filesystem::create_directories(directory, error);
+        if (error)
+            std::cout << "Failed to create the capture directory " << directory << ": " << error.message() << std::endl;
+
+        glCreateRenderbuffers(1, &colorRenderbuffer);
+        glNamedRenderbufferStorageMultisample(colorRenderbuffer, sampleCount > 1 ? sampleCount : 0, GL_RGBA8, size.x, size.y);
+        glCreateRenderbuffers(1, &depthRenderbuffer);
+        glNamedRenderbufferStorageMultisample(depthRenderbuffer, sampleCount > 1 ? sampleCount : 0, GL_DEPTH24_STENCIL8, size.x, size.y);
+        glCreateFramebuffers(1, &framebuffer);
+        glNamedFramebufferRenderbuffer(framebuffer, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, colorRenderbuffer);
+        glNamedFramebufferRenderbuffer(framebuffer, GL_DEPTH_STENCIL_ATTACHMENT, GL_RENDERBUFFER, depthRenderbuffer);
+
+        glCreateRenderbuffers(1, &resolveRenderbuffer);
+        glNamedRenderbufferStorage(resolveRenderbuffer, GL_RGBA8, size.x, size.y);
+        glCreateFramebuffers(1, &resolveFramebuffer);
+        glNamedFramebufferRenderbuffer(resolveFramebuffer, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, resolveRenderbuffer);
+
+        if (glCheckNamedFramebufferStatus(framebuffer, GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE ||
+            glCheckNamedFramebufferStatus(resolveFramebuffer, GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+            std::cout << "Frame capture framebuffers are incomplete" << std::endl;
+
+        const GLsizeiptr frameBytes = static_cast<GLsizeiptr>(size.x) * size.y * 4;
+        const GLbitfield mapFlags = GL_MAP_READ_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+        for (auto& slot : slots)
+        {
+            glCreateBuffers(1, &slot.pixelBuffer);
+            glNamedBufferStorage(slot.pixelBuffer, frameBytes, nullptr, mapFlags);
+            slot.pixels = static_cast<const uint8_t*>(glMapNamedBufferRange(slot.pixelBuffer, 0, frameBytes, mapFlags));
+        }
+
+        worker = std::thread(&FrameCapture::writeFrames, this);
+    }
+	~FrameCapture() {
+        // Every frame that was read back still reaches the disk
+        while (submittedFrames < capturedFrames)
+        {
+            submitFinishedReadbacks(true);
+        }
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stopping = true;
+        }
+        condition.notify_all();
+        worker.join();
+
+        for (auto& slot : slots)
+        {
+            glUnmapNamedBuffer(slot.pixelBuffer);
+            glDeleteBuffers(1, &slot.pixelBuffer);
+        }
+        glDeleteFramebuffers(1, &framebuffer);
+        glDeleteFramebuffers(1, &resolveFramebuffer);
+        glDeleteRenderbuffers(1, &colorRenderbuffer);
+        glDeleteRenderbuffers(1, &depthRenderbuffer);
+        glDeleteRenderbuffers(1, &resolveRenderbuffer);
+    }
+	FrameCapture(const FrameCapture&) = delete;
+	FrameCapture& operator=(const FrameCapture&) = delete;
+
+	// Redirects the frame's drawing to the offscreen target
+	void beginFrame() const {
+        glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+    }
+	// Resolves the frame, shows it in the window and queues its readback
+	void endFrame();
+
+	// The requested number of frames has been captured
+	bool isComplete() const { return frameLimit > 0 && capturedFrames >= frameLimit; }
+	void setProfiler(GpuProfiler* _profiler) { profiler = _profiler; }
+
+private:
+	struct Slot {
+		GLuint pixelBuffer = GL_NONE;
+		const uint8_t* pixels = nullptr;
+		GLsync fence = nullptr;
+		uint32_t frame = 0;
+		bool writing = false;			// Owned by the worker until the frame is on disk
+	};
+
+	void submitFinishedReadbacks(bool wait);
+	void writeFrames();
+	void writeTga(const Slot& slot);
+
+	glm::ivec2 size;
+	std::string directory;
+	uint32_t frameLimit;
+	uint32_t capturedFrames = 0;
+	uint32_t submittedFrames = 0;		// Oldest frame whose readback hasn't been handed to the worker
+	GLuint framebuffer = GL_NONE;
+	GLuint colorRenderbuffer = GL_NONE;
+	GLuint depthRenderbuffer = GL_NONE;
+	GLuint resolveFramebuffer = GL_NONE;
+	GLuint resolveRenderbuffer = GL_NONE;
+	std::array<Slot, FRAME_CAPTURE_RING_SIZE> slots;
+	GpuProfiler* profiler = nullptr;
+
+	std::thread worker;
+	std::mutex mutex;
+	std::condition_variable condition;
+	std::deque<Slot*> writeQueue;
+	bool stopping = false;
+	bool writeFailed = false;			// Only touched by the worker
+};
+
+inline void FrameCapture::endFrame()
+{
+    if (isComplete())
+        return;
+
+    Slot& slot = slots[capturedFrames % FRAME_CAPTURE_RING_SIZE];
+    // The ring is full, the oldest frame has to leave the GPU and then the disk before its buffer is reused
+    while (slot.fence)
+    {
+        submitFinishedReadbacks(true);
+    }
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        condition.wait(lock, [&slot] { return !slot.writing; });
+    }
+
+    if (profiler) profiler->begin("Frame capture");
+    glBlitNamedFramebuffer(framebuffer, resolveFramebuffer, 0, 0, size.x, size.y, 0, 0, size.x, size.y, GL_COLOR_BUFFER_BIT, GL_NEAREST);
+    glBlitNamedFramebuffer(resolveFramebuffer, 0, 0, 0, size.x, size.y, 0, 0, size.x, size.y, GL_COLOR_BUFFER_BIT, GL_NEAREST);
+
+    // BGRA is the native layout of most drivers and of TGA, the copy needs no conversion on either side
+    glBindFramebuffer(GL_READ_FRAMEBUFFER, resolveFramebuffer);
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, slot.pixelBuffer);
+    glPixelStorei(GL_PACK_ALIGNMENT, 4);
+    glReadPixels(0, 0, size.x, size.y, GL_BGRA, GL_UNSIGNED_BYTE, nullptr);
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, GL_NONE);
+    slot.fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    slot.frame = capturedFrames++;
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    if (profiler) profiler->end("Frame capture");
+
+    submitFinishedReadbacks(false);
+}
+
+// Hands finished readbacks to the worker in frame order. Waiting blocks on the oldest one.
+inline void FrameCapture::submitFinishedReadbacks(bool wait)
+{
+    while (submittedFrames < capturedFrames)
+    {
+        Slot& slot = slots[submittedFrames % FRAME_CAPTURE_RING_SIZE];
+        const GLenum status = glClientWaitSync(slot.fence, wait ? GL_SYNC_FLUSH_COMMANDS_BIT : 0, wait ? GL_TIMEOUT_IGNORED : 0);
+        if (status == GL_TIMEOUT_EXPIRED)
+            return;
+        if (status == GL_WAIT_FAILED)
+            std::cout << "Frame capture fence wait failed" << std::endl;
+
+        glDeleteSync(slot.fence);
+        slot.fence = nullptr;
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            slot.writing = true;
+            writeQueue.push_back(&slot);
+        }
+        condition.notify_all();
+        ++submittedFrames;
+        wait = false;
+    }
+}
+
+inline void FrameCapture::writeFrames()
+{
+    while (true)
+    {
+        Slot* slot = nullptr;
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            condition.wait(lock, [this] { return stopping || !writeQueue.empty(); });
+            if (writeQueue.empty())
+                return;
+            slot = writeQueue.front();
+            writeQueue.pop_front();
+        }
+
+        writeTga(*slot);
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            slot->writing = false;
+        }
+        condition.notify_all();
+    }
+}
+
+inline void FrameCapture::writeTga(const Slot& slot)
+{
+    std::ostringstream path;
+    path << directory << "/frame_" << std::setw(6) << std::setfill('0') << slot.frame << ".tga";
+    FILE* file = std::fopen(path.str().c_str(), "wb");
+    if (!file)
+    {
+        if (!writeFailed)
+            std::cout << "Failed to open " << path.str() << " for writing, later failures aren't reported" << std::endl;
+        writeFailed = true;
+        return;
+    }
+
+    // Uncompressed true color, rows from the bottom like the framebuffer. The fourth byte is declared as no alpha,
+    // blending leaves partial coverage in the framebuffer alpha that isn't meant as image transparency.
+    const uint8_t header[18] = {
+        0, 0, 2, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        static_cast<uint8_t>(size.x & 0xFF), static_cast<uint8_t>(size.x >> 8),
+        static_cast<uint8_t>(size.y & 0xFF), static_cast<uint8_t>(size.y >> 8),
+        32, 0
+    };
+    std::fwrite(header, 1, sizeof(header), file);
+    std::fwrite(slot.pixels, 1, static_cast<size_t>(size.x) * size.y * 4, file);
+    std::fclose(file);
+}
@@ -0,0 +1,140 @@
+#pragma once
+#include <glad/glad.h>
+#include <array>
+#include <chrono>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <vector>
+
+// Measures named GPU sections with timestamp queries. Results are read QUERY_LATENCY frames later,
+// so the CPU never waits for the GPU, and the averages are printed once per report interval.
+class GpuProfiler {
+public:
+	static constexpr uint32_t QUERY_LATENCY = 4;
+
+	explicit GpuProfiler(float reportInterval = 1.f) : reportInterval(reportInterval) {
+        lastReport = lastFrame = std::chrono::steady_clock::now();
+    }
+	~GpuProfiler() {
+        for (auto& section : sections)
+        {
+            glDeleteQueries(QUERY_LATENCY * 2, section.queries.data());
+        }
+    }
+	GpuProfiler(const GpuProfiler&) = delete;
+	GpuProfiler& operator=(const GpuProfiler&) = delete;
+
+	void begin(const std::string& name) {
+        Section& section = findSection(name);
+        const uint32_t slot = frameIndex % QUERY_LATENCY;
+        if (section.pending[slot])
+        {
+            collect(section, slot);
+        }
+        glQueryCounter(section.queries[slot * 2], GL_TIMESTAMP);
+    }
+	void end(const std::string& name) {
+        Section& section = findSection(name);
+        const uint32_t slot = frameIndex % QUERY_LATENCY;
+        glQueryCounter(section.queries[slot * 2 + 1], GL_TIMESTAMP);
+        section.pending[slot] = true;
+    }
+
+	// Called once per frame after the last section has ended
+	void nextFrame() {
+        const auto now = std::chrono::steady_clock::now();
+        cpuFrameTime += std::chrono::duration<double, std::milli>(now - lastFrame).count();
+        lastFrame = now;
+        ++frameIndex;
+        ++framesSinceReport;
+
+        const uint32_t oldestSlot = frameIndex % QUERY_LATENCY;
+        for (auto& section : sections)
+        {
+            GLint available = GL_FALSE;
+            if (section.pending[oldestSlot])
+            {
+                glGetQueryObjectiv(section.queries[oldestSlot * 2 + 1], GL_QUERY_RESULT_AVAILABLE, &available);
+            }
+
+            if (available)
+            {
+                collect(section, oldestSlot);
+            }
+        }
+
+        if (std::chrono::duration<float>(now - lastReport).count() >= reportInterval)
+        {
+            report();
+            lastReport = now;
+        }
+    }
+
+	void setEnabled(bool value) { enabled = value; }
+	bool isEnabled() const { return enabled; }
+
+private:
+	struct Section {
+        std::string name;
+        std::array<GLuint, QUERY_LATENCY * 2> queries{};
+        std::array<bool, QUERY_LATENCY> pending{};
+        double accumulatedTime = 0.0;
+        uint32_t sampleCount = 0;
+    };
+
+	Section& findSection(const std::string& name) {
+        for (auto& section : sections)
+        {
+            if (section.name == name)
+                return section;
+        }
+
+        Section section;
+        section.name = name;
+        glGenQueries(QUERY_LATENCY * 2, section.queries.data());
+        sections.push_back(section);
+        return sections.back();
+    }
+
+	static void collect(Section& section, uint32_t slot) {
+        GLuint64 beginTime, endTime;
+        glGetQueryObjectui64v(section.queries[slot * 2], GL_QUERY_RESULT, &beginTime);
+        glGetQueryObjectui64v(section.queries[slot * 2 + 1], GL_QUERY_RESULT, &endTime);
+        section.accumulatedTime += (endTime - beginTime) / 1e6;
+        ++section.sampleCount;
+        section.pending[slot] = false;
+    }
+
+	void report() {
+        if (enabled && framesSinceReport > 0)
+        {
+            std::cout << std::fixed << std::setprecision(3) << "[Profiler] CPU frame " << cpuFrameTime / framesSinceReport << " ms";
+            for (auto& section : sections)
+            {
+                if (section.sampleCount > 0)
+                {
+                    std::cout << " | " << section.name << " " << section.accumulatedTime / section.sampleCount << " ms";
+                }
+            }
+            std::cout << std::endl;
+        }
+
+        for (auto& section : sections)
+        {
+            section.accumulatedTime = 0.0;
+            section.sampleCount = 0;
+        }
+        cpuFrameTime = 0.0;
+        framesSinceReport = 0;
+    }
+
+	std::vector<Section> sections;
+	uint32_t frameIndex = 0;
+	uint32_t framesSinceReport = 0;
+	double cpuFrameTime = 0.0;
+	float reportInterval;
+	bool enabled = true;
+	std::chrono::steady_clock::time_point lastReport;
+	std::chrono::steady_clock::time_point lastFrame;
+};
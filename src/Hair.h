@@ -1,10 +1,22 @@
 #pragma once
 #include "ComputeShader.h"
+#include "GpuProfiler.h"
+#include "HairCollision.h"
+#include "CompactPositions.h"
+#include "HairCuller.h"
+#include "HairCurves.h"
+#include "HairFileImporter.h"
+#include "HairRibbons.h"
+#include "MeshCache.h"
+#include "MeshOptimizer.h"
+#include "WindField.h"
 #include "Sphere.h"
 #include "PathConfig.h"
-#include "OBJ_Loader.h"
-#include <glm/gtc/random.hpp>
+#include "ObjParser.h"
+#include "ScalpSampler.h"
 #include "glm/gtc/quaternion.hpp"
+#include <chrono>
+#include <filesystem>
 #include <memory>
 #include <vector>
 #include <array>
@@ -16,50 +28,264 @@ const float VELOCITY_DAMPING_COEFFICIENCY = 0.9f;
 
 const float PARTICLE_MASS = 0.1f;
 const uint32_t PARTICLE_PER_HAIR = 15U;
+const uint32_t MAX_PARTICLE_PER_HAIR = 50U;		// MAX_VERTICES_PER_STRAND of the solver
 const uint32_t MAX_HAIR_COUNT = 30000U;
 const float HAIR_LENGTH = 4.f;
+const uint32_t HEAD_FLOATS_PER_VERTEX = 6U;		// Position and normal
+const float SCALP_HAIRLINE_FADE = 0.2f;		// Distance over which the root density fades out at the hairline
+
+// Storage and integration variants of the solver, every option is compiled into the shaders as a define
+struct HairOptions {
+	bool halfPrecisionVelocities = false;	// Velocities packed with packHalf2x16, friction grid gathered at half precision
+	bool verletIntegration = false;			// Position Verlet, the velocity buffer holds the displacement of the last step
+	bool compactPositions = false;			// Roots and octahedral segment directions, 4 bytes per particle instead of 12
+	uint32_t particlesPerStrand = PARTICLE_PER_HAIR;	// Not a define, the solver reads it from a uniform
+	std::string groomPath;					// Cem Yuksel .hair file replacing the procedural strands, segment lengths per strand
+	glm::mat4 groomTransform{ 1.f };		// From the groom's space into the hair's model space
+	// Roots of the procedural strands, sampled by the hair when not set. Hairs on the same head share them by passing
+	// on the roots of the first one, see Hair::getScalpRoots.
+	std::shared_ptr<const std::vector<glm::vec3>> scalpRoots;
+
+	std::vector<std::string> getDefines() const {
+        std::vector<std::string> defines;
+        if (halfPrecisionVelocities)
+            defines.push_back("HALF_VELOCITIES");
+        if (verletIntegration)
+            defines.push_back("VERLET_INTEGRATION");
+        if (compactPositions)
+            defines.push_back("COMPACT_POSITIONS");
+        if (hasSegmentLengths())
+            defines.push_back("STRAND_SEGMENT_LENGTHS");
+        return defines;
+    }
+	// Compact positions decode every particle from the segment length, which is read from the per strand buffer
+	bool hasSegmentLengths() const { return !groomPath.empty() || compactPositions; }
+};
+
+struct HairParameters {
+	glm::vec4 wind = WIND;
+	float gravity = GRAVITY;
+	float frictionCoefficient = FRICTION_FACTOR;
+	float velocityDampingCoefficient = VELOCITY_DAMPING_COEFFICIENCY;
+};
 
 
 class Hair : public Entity {
 public:
-	Hair(uint32_t _strandCount)
-    : hair_count(_strandCount), computeShader("HairComputeShader.glsl")
+	Hair(uint32_t _strandCount, const HairOptions& _options = {})
+    : hair_count(_strandCount), options(_options), particlesPerStrand(glm::clamp(_options.particlesPerStrand, 2U, MAX_PARTICLE_PER_HAIR)),
+    computeShader("HairComputeShader.glsl", _options.getDefines()), collision(MAX_HAIR_COUNT * particlesPerStrand, _options.getDefines()),
+    culler(MAX_HAIR_COUNT, particlesPerStrand, _options.getDefines())
     {
         computeShader.use();
         computeShader.setUint("hairData.strandCount", hair_count);
         computeShader.setFloat("hairData.particleMass", PARTICLE_MASS);
-        computeShader.setFloat("force.gravity", GRAVITY);
-        computeShader.setVec4("force.wind", WIND);
-        computeShader.setFloat("frictionCoefficient", FRICTION_FACTOR);
-        computeShader.setFloat("velocityDampingCoefficient", VELOCITY_DAMPING_COEFFICIENCY);
+        setParameters(parameters);
+        computeShader.setInt("windField", 0);
+        computeShader.setVec3("windFieldMin", windField.getMin());
+        computeShader.setFloat("windFieldSize", windField.getSize());
         constructModel();
     }
 	~Hair() {
         glDeleteBuffers(1, &velocityArrayBuffer);
         glDeleteBuffers(1, &volumeDensities);
         glDeleteBuffers(1, &volumeVelocities);
+        glDeleteBuffers(1, &resolvedVolumeVelocities);
+        glDeleteBuffers(1, &segmentLengthBuffer);
+        glDeleteBuffers(1, &rootBuffer);
+        glDeleteVertexArrays(1, &headVao);
+        glDeleteBuffers(1, &headVbo);
+        glDeleteBuffers(1, &headEbo);
     }
 
 	void draw() const override {
-        glBindVertexArray(vao);
-        for (uint32_t i = 0; i < hair_count; ++i)
+        bindPositions();		// Read by the vertex pulling shader
+        if (ribbons)
         {
-            glDrawArrays(GL_LINE_STRIP, i * PARTICLE_PER_HAIR, PARTICLE_PER_HAIR);
+            ribbons->draw(hair_count);
+            return;
         }
+        if (curves)
+        {
+            curves->draw(hair_count);
+            return;
+        }
+
+        glBindVertexArray(vao);
+        if (cullingEnabled)
+            culler.draw(hair_count);
+        else
+            glMultiDrawArrays(GL_LINE_STRIP, strandFirsts.data(), strandCounts.data(), hair_count);
+        glBindVertexArray(GL_NONE);
+    }
+	// Every strand as a line strip, regardless of culling and ribbons, for passes that don't see the camera
+	void drawLines() const {
+        bindPositions();
+        glBindVertexArray(vao);
+        glMultiDrawArrays(GL_LINE_STRIP, strandFirsts.data(), strandCounts.data(), hair_count);
+        glBindVertexArray(GL_NONE);
+    }
+
+	// The head mesh in the hair's model space, drawn before the strands so its depth rejects the hidden hair fragments
+	void drawHead() const {
+        if (indexCount == 0)
+            return;
+
+        glBindVertexArray(headVao);
+        glDrawElements(GL_TRIANGLES, indexCount, GL_UNSIGNED_INT, nullptr);
         glBindVertexArray(GL_NONE);
     }
 
 	void applyPhysics(float deltaTime, float runningTime);
+	// Rebuilds the indirect draw buffer from the simulated positions, must run between applyPhysics and draw
+	void cull(const PerspectiveCamera& camera) {
+        if (!cullingEnabled)
+            return;
+
+        if (profiler) profiler->begin("Hair culling");
+        bindPositions();
+        culler.cull(camera, transformMatrix, hair_count);
+        if (profiler) profiler->end("Hair culling");
+    }
+	// Rebuilds the camera facing ribbons from the simulated positions, must run between applyPhysics and draw
+	void expandRibbons(const PerspectiveCamera& camera, float viewportHeight) {
+        if (!ribbons)
+            return;
+
+        if (profiler) profiler->begin("Hair ribbons");
+        bindPositions();
+        ribbons->generate(camera, transformMatrix, hair_count, viewportHeight);
+        if (profiler) profiler->end("Hair ribbons");
+    }
+
+	void setProfiler(GpuProfiler* _profiler) { profiler = _profiler; }
+	void setCollisionsEnabled(bool enabled) { collisionsEnabled = enabled; }
+	void setCullingEnabled(bool enabled) { cullingEnabled = enabled; }
+	// Level of detail is selected by the cull pass, so it only applies while culling is enabled
+	void setLodEnabled(bool enabled) { culler.setLodEnabled(enabled); }
+	void setLodWidthCompensation(bool enabled) { culler.setWidthCompensation(enabled); }
+	// Draws the strands as ribbons of the given width at the root instead of lines, 0 goes back to lines
+	void setRibbonWidth(float width) {
+        if (width <= 0.f)
+        {
+            ribbons.reset();
+            return;
+        }
+        if (!ribbons)
+            ribbons = std::make_unique<HairRibbons>(MAX_HAIR_COUNT, particlesPerStrand, options.getDefines());
+        ribbons->setRootWidth(width);
+    }
+	// Draws the strands as tessellated Catmull-Rom curves through the particles, with a TessellationShader
+	void setCurvesEnabled(bool enabled) {
+        if (!enabled)
+            curves.reset();
+        else if (!curves)
+            curves = std::make_unique<HairCurves>(MAX_HAIR_COUNT, particlesPerStrand);
+    }
+	WindField& getWindField() { return windField; }
+
+	void setParameters(const HairParameters& _parameters) {
+        parameters = _parameters;
+        computeShader.use();
+        computeShader.setFloat("force.gravity", parameters.gravity);
+        computeShader.setVec4("force.wind", parameters.wind);
+        computeShader.setFloat("frictionCoefficient", parameters.frictionCoefficient);
+        computeShader.setFloat("velocityDampingCoefficient", parameters.velocityDampingCoefficient);
+    }
+	const HairParameters& getParameters() const { return parameters; }
+
+	// With compact positions the buffer holds the segment directions, and the roots are in their own buffer
+	GLuint getPositionBuffer() const { return vbo; }
+	GLuint getRootBuffer() const { return rootBuffer; }
+	GLuint getVelocityBuffer() const { return velocityArrayBuffer; }
+	GLuint getSegmentLengthBuffer() const { return segmentLengthBuffer; }
+	// Length of the last step, the Verlet velocity buffer holds the displacement over it
+	float getLastDeltaTime() const { return lastDeltaTime; }
+	void setLastDeltaTime(float deltaTime) { lastDeltaTime = deltaTime; }
+	uint32_t getStrandCount() const { return hair_count; }
+	uint32_t getParticlesPerStrand() const { return particlesPerStrand; }
+	void setStrandCount(uint32_t strandCount) { hair_count = glm::min(strandCount, MAX_HAIR_COUNT); }
+	const HairOptions& getOptions() const { return options; }
+	// Roots the procedural strands grow from, null when a groom was imported
+	const std::shared_ptr<const std::vector<glm::vec3>>& getScalpRoots() const { return options.scalpRoots; }
+
+	// Places the head OBJ in the hair's model space
+	static glm::mat4 getHeadTransform() {
+        const glm::vec3 headTranslation(0.f, -3.f, 0.f);
+        const glm::vec3 headScale(0.2f);
+        glm::quat headRotation = glm::angleAxis(glm::radians(180.f), glm::vec3(0.f, 1.f, 0.f));
+        headRotation = glm::rotate(headRotation, glm::radians(-90.f), glm::vec3(1.f, 0.f, 0.f));
+        return glm::scale(glm::translate(glm::mat4(1.f), headTranslation) * glm::mat4_cast(headRotation), headScale);
+    }
+	// Density of the hair roots on the transformed head, 1 on the scalp, fading to 0 past the hairline
+	static float getScalpDensity(const glm::vec3& position) {
+        const auto region = [&position](float minimumY, float maximumZ) {
+            return glm::clamp((position.y - minimumY) / SCALP_HAIRLINE_FADE, 0.f, 1.f) * glm::clamp((maximumZ - position.z) / SCALP_HAIRLINE_FADE, 0.f, 1.f);
+        };
+        return std::max({ region(-1.f, 0.f), region(-0.5f, 0.7f), region(0.5f, 1.7f) });
+    }
+	float getEllipsoidsRadius() const { return ellipsoidsRadius; }
+	const glm::vec3& getHeadColor() const { return headColor; }
+	std::vector<glm::mat4> getColliderTransforms() const {
+        std::vector<glm::mat4> transforms;
+        transforms.reserve(ellipsoids.size());
+        for (const auto& e : ellipsoids)
+        {
+            transforms.push_back(transformMatrix * e->getTransformMatrix());
+        }
+        return transforms;
+    }
 
 private:
 	GLuint velocityArrayBuffer = GL_NONE;		// Shader storage buffer object for velocities
 	GLuint volumeDensities = GL_NONE;
 	GLuint volumeVelocities = GL_NONE;
+	GLuint resolvedVolumeVelocities = GL_NONE;	// Only used with half precision velocities
+	GLuint segmentLengthBuffer = GL_NONE;		// Only allocated for imported grooms and compact positions
+	GLuint rootBuffer = GL_NONE;				// Only allocated for compact positions
 
 	uint32_t hair_count;
+	HairOptions options;
+	uint32_t particlesPerStrand;
+	std::vector<GLint> strandFirsts;		// First vertex and vertex count of every strand, for a single multi draw
+	std::vector<GLsizei> strandCounts;
+	float lastDeltaTime = 0.f;
+	HairParameters parameters;
 
 	ComputeShader computeShader;
+	HairCollision collision;
+	WindField windField;
+	HairCuller culler;
+	std::unique_ptr<HairRibbons> ribbons;		// Only allocated when the strands are drawn as ribbons
+	std::unique_ptr<HairCurves> curves;			// Only allocated when the strands are drawn as curves
+	bool collisionsEnabled = true;
+	bool cullingEnabled = false;
+	GpuProfiler* profiler = nullptr;
 	void constructModel();
+	// Binds the buffers every shader reading the particle positions needs
+	void bindPositions() const {
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, vbo);
+        if (segmentLengthBuffer)
+            glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 19, segmentLengthBuffer);
+        if (rootBuffer)
+            glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 20, rootBuffer);
+        if (collision.getDecodedPositions())
+            glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 21, collision.getDecodedPositions());
+    }
+	// Allocates the position storage for MAX_HAIR_COUNT strands, directions and roots with compact positions
+	void allocatePositions();
+	// Uploads strands of float positions, encoded into roots and directions with compact positions
+	void uploadPositions(const std::vector<float>& positions);
+	// Straight strands growing out of blue noise roots over the scalp
+	void generateStrands(const std::vector<glm::vec3>& headPositions, const std::vector<uint32_t>& headIndices);
+	static std::shared_ptr<const std::vector<glm::vec3>> sampleScalpRoots(const std::vector<glm::vec3>& headPositions,
+		const std::vector<uint32_t>& headIndices);
+	// Uploads the strands of the groom file, fails when it can't be imported
+	bool importGroom();
+	// Loads the head from its binary cache, or parses the OBJ and rebuilds the cache when it is missing or stale.
+	// Returns the transformed head positions and their triangles, the hair roots are sampled on them.
+	std::vector<glm::vec3> loadHead(const glm::mat4& headTransform, std::vector<uint32_t>& headIndices);
+	void uploadHead(const float* vertices, uint32_t vertexCount, const uint32_t* indices, uint32_t headIndexCount);
 
 	// Head variables
 	glm::vec3 headColor;
@@ -70,6 +296,137 @@ private:
 	std::array<std::unique_ptr<Sphere>, 7> ellipsoids;
 	float ellipsoidsRadius = 0.5f;
 };
+inline std::vector<glm::vec3> Hair::loadHead(const glm::mat4& headTransform, std::vector<uint32_t>& headIndices)
+{
+    const std::string sourcePath = TEXTURE_FOLDER + "FemaleHead/FemaleHead.obj";
+    const std::string cachePath = CACHE_FOLDER + "FemaleHead.meshcache";
+    uint64_t sourceHash = 0;
+    if (!MeshCache::hashFileStamp(sourcePath, sourceHash))
+    {
+        std::cout << "File doesn't exist" << std::endl;
+        return {};
+    }
+    sourceHash = MeshCache::hash(&headTransform, sizeof(headTransform), sourceHash);
+
+    MeshCache cache;
+    if (cache.load(cachePath, sourceHash, HEAD_FLOATS_PER_VERTEX))
+    {
+        uploadHead(cache.getVertices(), cache.getVertexCount(), cache.getIndices(), cache.getIndexCount());
+        headIndices.assign(cache.getIndices(), cache.getIndices() + cache.getIndexCount());
+        std::vector<glm::vec3> headPositions(cache.getVertexCount());
+        for (uint32_t i = 0; i < cache.getVertexCount(); ++i)
+        {
+            const float* vertex = cache.getVertices() + i * HEAD_FLOATS_PER_VERTEX;
+            headPositions[i] = glm::vec3(vertex[0], vertex[1], vertex[2]);
+        }
+        return headPositions;
+    }
+
+    ObjMesh mesh;
+    if (!ObjParser::parse(sourcePath, mesh))
+    {
+        std::cout << "Failed to parse " << sourcePath << std::endl;
+        return {};
+    }
+
+    const glm::mat3 normalMatrix = glm::transpose(glm::inverse(glm::mat3(headTransform)));
+    std::vector<float>& headData = mesh.vertices;
+    std::vector<glm::vec3> headPositions(mesh.getVertexCount());
+    for (uint32_t i = 0; i < mesh.getVertexCount(); ++i)
+    {
+        float* vertex = &headData[i * HEAD_FLOATS_PER_VERTEX];
+        const glm::vec3 position = headTransform * glm::vec4(vertex[0], vertex[1], vertex[2], 1.f);
+        const glm::vec3 normal = normalMatrix * glm::vec3(vertex[3], vertex[4], vertex[5]);
+        std::copy_n(&position.x, 3, vertex);
+        std::copy_n(&normal.x, 3, vertex + 3);
+        headPositions[i] = position;
+    }
+
+    // The head never changes, so its triangles are reordered once for the vertex cache and for early depth rejection
+    headIndices = MeshOptimizer::optimizeVertexCache(mesh.indices, static_cast<uint32_t>(headPositions.size()));
+    headIndices = MeshOptimizer::optimizeOverdraw(headIndices, headPositions);
+
+    std::error_code error;
+    std::filesystem::create_directories(CACHE_FOLDER, error);
+    if (!MeshCache::write(cachePath, sourceHash, HEAD_FLOATS_PER_VERTEX, headData, headIndices))
+        std::cout << "Failed to write the head mesh cache " << cachePath << std::endl;
+
+    uploadHead(headData.data(), static_cast<uint32_t>(headPositions.size()), headIndices.data(), static_cast<uint32_t>(headIndices.size()));
+    return headPositions;
+}
+
+inline void Hair::uploadHead(const float* vertices, uint32_t vertexCount, const uint32_t* indices, uint32_t headIndexCount)
+{
+    glCreateVertexArrays(1, &headVao);
+    glCreateBuffers(1, &headVbo);
+    glCreateBuffers(1, &headEbo);
+    glNamedBufferStorage(headVbo, static_cast<GLsizeiptr>(vertexCount) * HEAD_FLOATS_PER_VERTEX * sizeof(float), vertices, 0);
+    glNamedBufferStorage(headEbo, static_cast<GLsizeiptr>(headIndexCount) * sizeof(GLuint), indices, 0);
+    glBindVertexArray(headVao);
+    glBindBuffer(GL_ARRAY_BUFFER, headVbo);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, headEbo);
+    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, HEAD_FLOATS_PER_VERTEX * sizeof(float), 0);
+    glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, HEAD_FLOATS_PER_VERTEX * sizeof(float), (void*)(3 * sizeof(float)));
+    glEnableVertexAttribArray(0);
+    glEnableVertexAttribArray(1);
+    glBindBuffer(GL_ARRAY_BUFFER, GL_NONE);
+    glBindVertexArray(GL_NONE);
+    indexCount = headIndexCount;
+}
+
+inline bool Hair::importGroom()
+{
+    const HairFileImporter importer(options.groomPath);
+    const uint32_t importedCount = importer.import(vbo, segmentLengthBuffer, MAX_HAIR_COUNT, particlesPerStrand, options.groomTransform, rootBuffer);
+    if (importedCount == 0)
+    {
+        std::cout << "Failed to import the groom " << options.groomPath << ", using the procedural strands" << std::endl;
+        return false;
+    }
+
+    hair_count = importedCount;
+    std::cout << "Imported " << importedCount << " of " << importer.getStrandCount() << " strands from " << options.groomPath << std::endl;
+    return true;
+}
+
+inline std::shared_ptr<const std::vector<glm::vec3>> Hair::sampleScalpRoots(const std::vector<glm::vec3>& headPositions,
+    const std::vector<uint32_t>& headIndices)
+{
+    // The roots come in random order, so the strands drawn with a lower strand count still cover the whole scalp
+    const auto samplingStart = std::chrono::steady_clock::now();
+    ScalpSampler sampler(headPositions, headIndices, &Hair::getScalpDensity);
+    std::vector<glm::vec3> roots = sampler.sample(MAX_HAIR_COUNT);
+    std::cout << "Sampled " << roots.size() << " hair roots " << sampler.getRadius() << " apart in " <<
+        std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - samplingStart).count() << " ms" << std::endl;
+    // Without a head there is a single strand on top, a scalp too small for every strand repeats the roots
+    if (roots.empty())
+        roots.push_back(glm::vec3(0.f, 1.f, 0.f));
+    return std::make_shared<const std::vector<glm::vec3>>(std::move(roots));
+}
+
+inline void Hair::generateStrands(const std::vector<glm::vec3>& headPositions, const std::vector<uint32_t>& headIndices)
+{
+    const float segmentLength = HAIR_LENGTH / (particlesPerStrand - 1);
+    if (!options.scalpRoots)
+        options.scalpRoots = sampleScalpRoots(headPositions, headIndices);
+    const std::vector<glm::vec3>& roots = *options.scalpRoots;
+
+    std::vector<float> data;
+    data.reserve(MAX_HAIR_COUNT * particlesPerStrand * 3);
+    for (uint32_t i = 0; i < MAX_HAIR_COUNT; ++i)
+    {
+        const glm::vec3& root = roots[i % roots.size()];
+        for (uint32_t j = 0; j < particlesPerStrand; ++j)
+        {
+            glm::vec3 particle = root + glm::normalize(root) * (float)j * segmentLength;
+            data.push_back(particle.x);
+            data.push_back(particle.y);
+            data.push_back(particle.z);
+        }
+    }
+    uploadPositions(data);
+}
+
 inline void Hair::constructModel()
 {
     for (auto& e : ellipsoids) {
@@ -106,116 +463,41 @@ inline void Hair::constructModel()
     ellipsoids[6]->translate(glm::vec3(-0.015701f, -1.032532f, 0.122619f));
     ellipsoids[6]->scale(glm::vec3(2.357361f, 3.127426f, 2.326767f));
 
-    const glm::vec3 headTranslation(0.f, -3.f, 0.f);
-    const glm::vec3 headScale(0.2f);
-    glm::quat headRotation = glm::angleAxis(glm::radians(180.f), glm::vec3(0.f, 1.f, 0.f));
-    headRotation = glm::rotate(headRotation, glm::radians(-90.f), glm::vec3(1.f, 0.f, 0.f));
-    glm::mat4 headTransform = glm::scale(glm::translate(glm::mat4(1.f), headTranslation) * glm::mat4_cast(headRotation), headScale);
+    const glm::mat4 headTransform = getHeadTransform();
     headColor = glm::vec3(0.85f, 0.48f, 0.2f);
 
-    objl::Loader loader;
-    std::vector<float> headData;
-    if (loader.LoadFile(TEXTURE_FOLDER + "FemaleHead/FemaleHead.obj"))
-    {
-        headData.reserve(loader.LoadedVertices.size() * 6 * 3); // 3 position component and 3 normal components
-        for (auto& vertex : loader.LoadedVertices)
-        {
-            glm::vec3 transformedVertex = headTransform * glm::vec4(vertex.Position.X, vertex.Position.Y, vertex.Position.Z, 1.f);
-            vertex.Position.X = transformedVertex.x;
-            vertex.Position.Y = transformedVertex.y;
-            vertex.Position.Z = transformedVertex.z;
-
-            glm::vec3 transformedNormal = glm::inverse(glm::transpose(headTransform)) * glm::vec4(vertex.Normal.X, vertex.Normal.Y, vertex.Normal.Z, 1.f);
-            vertex.Normal.X = transformedNormal.x;
-            vertex.Normal.Y = transformedNormal.y;
-            vertex.Normal.Z = transformedNormal.z;
-
-            headData.push_back(vertex.Position.X);
-            headData.push_back(vertex.Position.Y);
-            headData.push_back(vertex.Position.Z);
-            headData.push_back(vertex.Normal.X);
-            headData.push_back(vertex.Normal.Y);
-            headData.push_back(vertex.Normal.Z);
-        }
-
-        glCreateVertexArrays(1, &headVao);
-        glGenBuffers(1, &headVbo);
-        glGenBuffers(1, &headEbo);
-        glBindVertexArray(headVao);
-        glBindBuffer(GL_ARRAY_BUFFER, headVbo);
-        glBufferData(GL_ARRAY_BUFFER, headData.size() * sizeof(float), headData.data(), GL_DYNAMIC_DRAW);
-        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, headEbo);
-        glBufferData(GL_ELEMENT_ARRAY_BUFFER, loader.LoadedIndices.size() * sizeof(GLuint), loader.LoadedIndices.data(), GL_DYNAMIC_DRAW);
-        glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 6 * sizeof(float), 0);
-        glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, 6 * sizeof(float), (void*)(3 * sizeof(float)));
-        glEnableVertexAttribArray(0);
-        glEnableVertexAttribArray(1);
-        glBindBuffer(GL_ARRAY_BUFFER, GL_NONE);
-        glBindVertexArray(GL_NONE);
-        indexCount = loader.LoadedIndices.size();
-    }
-    else
-    {
-        std::cout << "File doesn't exist" << std::endl;
-    }
-
-    std::vector<float> data;
-    data.reserve(MAX_HAIR_COUNT * PARTICLE_PER_HAIR * 3);
+    std::vector<uint32_t> headIndices;
+    const std::vector<glm::vec3> headPositions = loadHead(headTransform, headIndices);
 
-    float segmentLength = HAIR_LENGTH/ (PARTICLE_PER_HAIR - 1);
+    float segmentLength = HAIR_LENGTH/ (particlesPerStrand - 1);
 
-    computeShader.setFloat("hairData.segmentLength", HAIR_LENGTH/ (PARTICLE_PER_HAIR - 1));
-    computeShader.setUint("hairData.particlesPerStrand", PARTICLE_PER_HAIR);
+    computeShader.setFloat("hairData.segmentLength", HAIR_LENGTH/ (particlesPerStrand - 1));
+    computeShader.setUint("hairData.particlesPerStrand", particlesPerStrand);
     computeShader.setFloat("ellipsoidRadius", ellipsoidsRadius);
-    uint32_t counter = 0;
-    for (uint32_t i = 0; i < loader.LoadedVertices.size(); i += 10)
+
+    strandFirsts.resize(MAX_HAIR_COUNT);
+    strandCounts.assign(MAX_HAIR_COUNT, particlesPerStrand);
+    for (uint32_t i = 0; i < MAX_HAIR_COUNT; ++i)
     {
-        const auto& vertex = loader.LoadedVertices[i];
-        if ((vertex.Position.Y > -1.f && vertex.Position.Z < 0.f) || (vertex.Position.Y > -0.5f && vertex.Position.Z < 0.7f) || (vertex.Position.Y >= 0.5f && vertex.Position.Z < 1.7f))
-        {
-            ++counter;
-            if (counter >= MAX_HAIR_COUNT- 1) break;
-            for (uint32_t j = 0; j < PARTICLE_PER_HAIR; ++j)
-            {
-                glm::vec3 particle(vertex.Position.X, vertex.Position.Y, vertex.Position.Z);
-                particle += glm::normalize(particle) * (float)j * segmentLength;
-                data.push_back(particle.x);
-                data.push_back(particle.y);
-                data.push_back(particle.z);
-            }
-        }
+        strandFirsts[i] = i * particlesPerStrand;
     }
 
-    const int strandsOnHair = counter;
-    for (; counter < MAX_HAIR_COUNT; ++counter)
+    if (options.hasSegmentLengths())
     {
-        int randomNumber = glm::linearRand(0, strandsOnHair - 1) * PARTICLE_PER_HAIR * 3;
-        glm::vec3 firstCoords(data[randomNumber], data[randomNumber + 1], data[randomNumber + 2]);
-        randomNumber += PARTICLE_PER_HAIR * 3;
-        glm::vec3 secondCoords(data[randomNumber], data[randomNumber + 1], data[randomNumber + 2]);
-        glm::vec3 coordsBetween = secondCoords + (firstCoords - secondCoords) * 0.5f;
-        for (uint32_t j = 0; j < PARTICLE_PER_HAIR; ++j)
-        {
-            glm::vec3 particle = coordsBetween + glm::normalize(coordsBetween) * (float)j * segmentLength;
-            data.push_back(particle.x);
-            data.push_back(particle.y);
-            data.push_back(particle.z);
-        }
+        glCreateBuffers(1, &segmentLengthBuffer);
+        glNamedBufferStorage(segmentLengthBuffer, MAX_HAIR_COUNT * sizeof(float), nullptr, GL_DYNAMIC_STORAGE_BIT);
+        glClearNamedBufferData(segmentLengthBuffer, GL_R32F, GL_RED, GL_FLOAT, &segmentLength);
     }
+    allocatePositions();
+    // A groom replaces the procedural strands, they are only generated without one or when it fails to import
+    if (options.groomPath.empty() || !importGroom())
+        generateStrands(headPositions, headIndices);
 
-    glBindVertexArray(vao);
-    glBindBuffer(GL_ARRAY_BUFFER, vbo);
-    glBufferData(GL_ARRAY_BUFFER, data.size() * sizeof(float), data.data(), GL_DYNAMIC_DRAW);
-    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 0, 0);
-    glEnableVertexAttribArray(0);
-    glBindVertexArray(GL_NONE);
-    glBindBuffer(GL_ARRAY_BUFFER, GL_NONE);
-    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, vbo);
-
-    // Velocities
-    data.clear();
-    data.reserve(MAX_HAIR_COUNT * PARTICLE_PER_HAIR * 3);
-    for (uint32_t i = 0; i < MAX_HAIR_COUNT * PARTICLE_PER_HAIR * 3; ++i)
+    // Velocities, either three floats or two words of packed halves per particle (zero bits are zero in both)
+    const uint32_t velocityComponents = options.halfPrecisionVelocities ? 2 : 3;
+    std::vector<float> data;
+    data.reserve(MAX_HAIR_COUNT * particlesPerStrand * velocityComponents);
+    for (uint32_t i = 0; i < MAX_HAIR_COUNT * particlesPerStrand * velocityComponents; ++i)
         data.push_back(0.f);
 
     glGenBuffers(1, &velocityArrayBuffer);
@@ -235,11 +517,67 @@ inline void Hair::constructModel()
     glBufferData(GL_SHADER_STORAGE_BUFFER, voxelGridSize, nullptr, GL_DYNAMIC_DRAW);
     glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 3, volumeVelocities);
 
+    if (options.halfPrecisionVelocities)
+    {
+        voxelGridSize = 11 * 11 * 11 * 2 * sizeof(GLuint);	// 3 packed half components in 2 words
+        glGenBuffers(1, &resolvedVolumeVelocities);
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, resolvedVolumeVelocities);
+        glBufferData(GL_SHADER_STORAGE_BUFFER, voxelGridSize, nullptr, GL_DYNAMIC_DRAW);
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 12, resolvedVolumeVelocities);
+    }
+
     glBindBuffer(GL_SHADER_STORAGE_BUFFER, GL_NONE);
 }
 
+inline void Hair::allocatePositions()
+{
+    // Only the vertex pulling shaders read compact positions, the vertex array has no attributes
+    const GLsizeiptr particleCount = static_cast<GLsizeiptr>(MAX_HAIR_COUNT) * particlesPerStrand;
+    glBindVertexArray(vao);
+    glBindBuffer(GL_ARRAY_BUFFER, vbo);
+    glBufferData(GL_ARRAY_BUFFER, particleCount * (options.compactPositions ? sizeof(uint32_t) : sizeof(glm::vec3)), nullptr, GL_DYNAMIC_DRAW);
+    if (!options.compactPositions)
+    {
+        glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 0, 0);
+        glEnableVertexAttribArray(0);
+    }
+    glBindVertexArray(GL_NONE);
+    glBindBuffer(GL_ARRAY_BUFFER, GL_NONE);
+
+    if (options.compactPositions)
+    {
+        glCreateBuffers(1, &rootBuffer);
+        glNamedBufferStorage(rootBuffer, MAX_HAIR_COUNT * sizeof(glm::vec3), nullptr, GL_DYNAMIC_STORAGE_BIT);
+    }
+}
+
+inline void Hair::uploadPositions(const std::vector<float>& positions)
+{
+    if (!options.compactPositions)
+    {
+        glNamedBufferSubData(vbo, 0, positions.size() * sizeof(float), positions.data());
+        return;
+    }
+
+    const uint32_t strandCount = static_cast<uint32_t>(positions.size() / (3 * particlesPerStrand));
+    std::vector<glm::vec3> roots(strandCount);
+    std::vector<uint32_t> directions(static_cast<size_t>(strandCount) * particlesPerStrand);
+    CompactPositions::encodeStrands(reinterpret_cast<const glm::vec3*>(positions.data()), strandCount, particlesPerStrand,
+        roots.data(), directions.data());
+    glNamedBufferSubData(vbo, 0, directions.size() * sizeof(uint32_t), directions.data());
+    glNamedBufferSubData(rootBuffer, 0, roots.size() * sizeof(glm::vec3), roots.data());
+}
+
 inline void Hair::applyPhysics(float deltaTime, float runningTime)
 {
+    // Several hairs may exist at once, so the binding points set in constructModel can't be relied on
+    bindPositions();
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 1, velocityArrayBuffer);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 2, volumeDensities);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 3, volumeVelocities);
+    if (options.halfPrecisionVelocities)
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 12, resolvedVolumeVelocities);
+
     glBindBuffer(GL_SHADER_STORAGE_BUFFER, volumeDensities);
     int* densities = (int*)glMapBuffer(GL_SHADER_STORAGE_BUFFER, GL_WRITE_ONLY);
     uint32_t volumeSize = 11 * 11 * 11;
@@ -259,6 +597,11 @@ inline void Hair::applyPhysics(float deltaTime, float runningTime)
     glUnmapBuffer(GL_SHADER_STORAGE_BUFFER);
     glBindBuffer(GL_SHADER_STORAGE_BUFFER, GL_NONE);
 
+    if (profiler) profiler->begin("Wind field");
+    windField.update(runningTime);
+    windField.bind(0);
+    if (profiler) profiler->end("Wind field");
+
     computeShader.use();
 
     for (uint32_t i = 0; i < ellipsoids.size(); ++i)
@@ -270,6 +613,11 @@ inline void Hair::applyPhysics(float deltaTime, float runningTime)
     computeShader.setUint("hairData.strandCount", hair_count);
     computeShader.setFloat("deltaTime", deltaTime);
     computeShader.setFloat("runningTime", runningTime);
+    if (options.verletIntegration)
+    {
+        computeShader.setFloat("lastDeltaTime", lastDeltaTime > 0.f ? lastDeltaTime : deltaTime);
+        lastDeltaTime = deltaTime;
+    }
     computeShader.setUint("state", 0);
     GLuint localWorkGroupCountX = computeShader.getLocalWorkGroupsCount().x;
     GLuint globalWorkGroupCount = hair_count / localWorkGroupCountX;
@@ -282,8 +630,10 @@ inline void Hair::applyPhysics(float deltaTime, float runningTime)
     computeShader.dispatch();
     glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
 
-    globalWorkGroupCount = hair_count * PARTICLE_PER_HAIR / localWorkGroupCountX;
-    if ((hair_count * PARTICLE_PER_HAIR) % localWorkGroupCountX != 0)
+    // Compact positions fill the volumes and add the friction with one invocation per strand, which decodes it once
+    const uint32_t volumeInvocationCount = options.compactPositions ? hair_count : hair_count * particlesPerStrand;
+    globalWorkGroupCount = volumeInvocationCount / localWorkGroupCountX;
+    if (volumeInvocationCount % localWorkGroupCountX != 0)
     {
         globalWorkGroupCount += 1;
     }
@@ -292,6 +642,29 @@ inline void Hair::applyPhysics(float deltaTime, float runningTime)
     computeShader.dispatch();
     glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
 
+    if (options.halfPrecisionVelocities)
+    {
+        computeShader.setGlobalWorkGroupCount((11 * 11 * 11 + localWorkGroupCountX - 1) / localWorkGroupCountX);
+        computeShader.setUint("state", 3);
+        computeShader.dispatch();
+        glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+        computeShader.setGlobalWorkGroupCount(globalWorkGroupCount);
+    }
+
     computeShader.setUint("state", 2);
     computeShader.dispatch();
+
+    // Compact strands are decoded once per step, for the collisions and for every pass drawing the strands
+    if (options.compactPositions)
+    {
+        glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+        collision.decode(transformMatrix, hair_count * particlesPerStrand, particlesPerStrand);
+    }
+    if (collisionsEnabled)
+    {
+        glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+        if (profiler) profiler->begin("Hair collision");
+        collision.resolve(transformMatrix, hair_count * particlesPerStrand, particlesPerStrand, deltaTime);
+        if (profiler) profiler->end("Hair collision");
+    }
 }
@@ -0,0 +1,299 @@
+#pragma once
+#include "Hair.h"
+
+// Matches the std430 layout of HairInstance in HairInstance.glsl
+struct HairInstanceData {
+	glm::mat4 model;
+	glm::vec4 wind;
+	float gravity;
+	float frictionCoefficient;
+	float velocityDampingCoefficient;
+	uint32_t strandOffset;
+	uint32_t strandCount;
+	uint32_t colliderOffset;
+	uint32_t colliderCount;
+	uint32_t padding;
+};
+static_assert(sizeof(HairInstanceData) == 112, "HairInstanceData has to match the std430 layout of HairInstance");
+
+// Simulates several hairs with one set of dispatches. Strands of all instances are concatenated into
+// shared buffers and every strand looks up its model matrix, colliders and parameters in a per-instance
+// table. Source hairs provide the initial state, transforms and colliders, so they have to outlive the batch.
+// Drawing requires a hair shader compiled with the BATCHED define. The batch runs full precision Heun integration on
+// uniform segment lengths, so the source hairs have to be built with default options apart from the particles per
+// strand, which they all have to share. Other hairs are refused and leave the batch empty.
+class HairBatch {
+public:
+	explicit HairBatch(const std::vector<const Hair*>& _hairs)
+    : hairs(canBatch(_hairs) ? _hairs : std::vector<const Hair*>{}), parameters(hairs.size()), strandCount(countStrands(hairs)),
+    particlesPerStrand(hairs.empty() ? PARTICLE_PER_HAIR : hairs[0]->getParticlesPerStrand()),
+    computeShader("HairComputeShader.glsl", { "BATCHED" }), collision(strandCount * particlesPerStrand, { "BATCHED" })
+    {
+        computeShader.use();
+        computeShader.setUint("hairData.strandCount", strandCount);
+        computeShader.setUint("hairData.particlesPerStrand", particlesPerStrand);
+        computeShader.setFloat("hairData.particleMass", PARTICLE_MASS);
+        computeShader.setFloat("hairData.segmentLength", HAIR_LENGTH / (particlesPerStrand - 1));
+        computeShader.setFloat("ellipsoidRadius", hairs.empty() ? 0.f : hairs[0]->getEllipsoidsRadius());
+        computeShader.setInt("windField", 0);
+        computeShader.setVec3("windFieldMin", windField.getMin());
+        computeShader.setFloat("windFieldSize", windField.getSize());
+        constructBuffers();
+    }
+	~HairBatch() {
+        glDeleteBuffers(1, &positionBuffer);
+        glDeleteBuffers(1, &velocityBuffer);
+        glDeleteBuffers(1, &volumeDensities);
+        glDeleteBuffers(1, &volumeVelocities);
+        glDeleteBuffers(1, &instanceBuffer);
+        glDeleteBuffers(1, &strandInstanceBuffer);
+        glDeleteBuffers(1, &colliderBuffer);
+        glDeleteVertexArrays(1, &vao);
+    }
+	HairBatch(const HairBatch&) = delete;
+	HairBatch& operator=(const HairBatch&) = delete;
+
+	void draw() const {
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, positionBuffer);
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 9, instanceBuffer);
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 10, strandInstanceBuffer);
+        glBindVertexArray(vao);
+        glMultiDrawArrays(GL_LINE_STRIP, strandFirsts.data(), strandCounts.data(), strandCount);
+        glBindVertexArray(GL_NONE);
+    }
+
+	void applyPhysics(float deltaTime, float runningTime);
+
+	void setParameters(uint32_t instance, const HairParameters& instanceParameters) { parameters[instance] = instanceParameters; }
+	void setProfiler(GpuProfiler* _profiler) { profiler = _profiler; }
+	void setCollisionsEnabled(bool enabled) { collisionsEnabled = enabled; }
+	WindField& getWindField() { return windField; }
+	bool isValid() const { return !hairs.empty(); }
+	uint32_t getInstanceCount() const { return static_cast<uint32_t>(hairs.size()); }
+	uint32_t getStrandCount() const { return strandCount; }
+	uint32_t getParticlesPerStrand() const { return particlesPerStrand; }
+
+private:
+	static bool canBatch(const std::vector<const Hair*>& hairs) {
+        for (const Hair* hair : hairs)
+        {
+            if (!hair->getOptions().getDefines().empty())
+            {
+                std::cout << "Batched hairs can't use half precision, Verlet integration, compact positions or grooms" << std::endl;
+                return false;
+            }
+            if (hair->getParticlesPerStrand() != hairs[0]->getParticlesPerStrand())
+            {
+                std::cout << "Batched hairs need the same number of particles per strand, got " << hairs[0]->getParticlesPerStrand() <<
+                    " and " << hair->getParticlesPerStrand() << std::endl;
+                return false;
+            }
+        }
+        return true;
+    }
+
+	static uint32_t countStrands(const std::vector<const Hair*>& hairs) {
+        uint32_t count = 0;
+        for (const Hair* hair : hairs)
+        {
+            count += hair->getStrandCount();
+        }
+        return count;
+    }
+
+	void constructBuffers();
+	void updateInstances();
+
+	std::vector<const Hair*> hairs;
+	std::vector<HairParameters> parameters;
+	std::vector<HairInstanceData> instances;
+	std::vector<glm::mat4> colliders;		// Collider transform followed by its inverse
+	uint32_t strandCount;
+	uint32_t particlesPerStrand;
+	std::vector<GLint> strandFirsts;
+	std::vector<GLsizei> strandCounts;
+
+	ComputeShader computeShader;
+	HairCollision collision;
+	WindField windField;				// Sampled relative to the origin of every instance
+	bool collisionsEnabled = true;
+	GpuProfiler* profiler = nullptr;
+
+	GLuint positionBuffer = GL_NONE;
+	GLuint velocityBuffer = GL_NONE;
+	GLuint volumeDensities = GL_NONE;
+	GLuint volumeVelocities = GL_NONE;
+	GLuint instanceBuffer = GL_NONE;
+	GLuint strandInstanceBuffer = GL_NONE;
+	GLuint colliderBuffer = GL_NONE;
+	GLuint vao = GL_NONE;
+};
+
+inline void HairBatch::constructBuffers()
+{
+    const GLsizeiptr strandSize = particlesPerStrand * 3 * sizeof(float);
+    glGenBuffers(1, &positionBuffer);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, positionBuffer);
+    glBufferData(GL_COPY_WRITE_BUFFER, strandCount * strandSize, nullptr, GL_DYNAMIC_DRAW);
+    glGenBuffers(1, &velocityBuffer);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, velocityBuffer);
+    glBufferData(GL_COPY_WRITE_BUFFER, strandCount * strandSize, nullptr, GL_DYNAMIC_DRAW);
+
+    std::vector<GLuint> strandInstances;
+    strandInstances.reserve(strandCount);
+    std::vector<glm::vec3> strandPositions;
+    uint32_t strandOffset = 0;
+    for (uint32_t i = 0; i < hairs.size(); ++i)
+    {
+        const Hair* hair = hairs[i];
+        const GLsizeiptr copySize = hair->getStrandCount() * strandSize;
+
+        // Hairs are built around the origin, so everything but the roots (kept in model space) is moved to the instance
+        strandPositions.resize(hair->getStrandCount() * particlesPerStrand);
+        glBindBuffer(GL_COPY_READ_BUFFER, hair->getPositionBuffer());
+        glGetBufferSubData(GL_COPY_READ_BUFFER, 0, copySize, strandPositions.data());
+        for (uint32_t j = 0; j < strandPositions.size(); ++j)
+        {
+            if (j % particlesPerStrand != 0)
+                strandPositions[j] = hair->getTransformMatrix() * glm::vec4(strandPositions[j], 1.f);
+        }
+        glBindBuffer(GL_COPY_WRITE_BUFFER, positionBuffer);
+        glBufferSubData(GL_COPY_WRITE_BUFFER, strandOffset * strandSize, copySize, strandPositions.data());
+
+        glBindBuffer(GL_COPY_WRITE_BUFFER, velocityBuffer);
+        glBindBuffer(GL_COPY_READ_BUFFER, hair->getVelocityBuffer());
+        glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, 0, strandOffset * strandSize, copySize);
+
+        HairInstanceData instance{};
+        instance.strandOffset = strandOffset;
+        instance.strandCount = hair->getStrandCount();
+        instance.colliderOffset = static_cast<uint32_t>(colliders.size() / 2);
+        instance.colliderCount = static_cast<uint32_t>(hair->getColliderTransforms().size());
+        instances.push_back(instance);
+        colliders.resize(colliders.size() + instance.colliderCount * 2);
+
+        strandInstances.insert(strandInstances.end(), hair->getStrandCount(), i);
+        strandOffset += hair->getStrandCount();
+    }
+    glBindBuffer(GL_COPY_READ_BUFFER, GL_NONE);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, GL_NONE);
+
+    GLsizeiptr voxelGridSize = hairs.size() * 11 * 11 * 11 * sizeof(float); // One 11x11x11 grid per instance
+    glGenBuffers(1, &volumeDensities);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, volumeDensities);
+    glBufferData(GL_SHADER_STORAGE_BUFFER, voxelGridSize, nullptr, GL_DYNAMIC_DRAW);
+
+    voxelGridSize *= 3;	// 3-component vectors
+    glGenBuffers(1, &volumeVelocities);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, volumeVelocities);
+    glBufferData(GL_SHADER_STORAGE_BUFFER, voxelGridSize, nullptr, GL_DYNAMIC_DRAW);
+
+    glGenBuffers(1, &instanceBuffer);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, instanceBuffer);
+    glBufferData(GL_SHADER_STORAGE_BUFFER, instances.size() * sizeof(HairInstanceData), nullptr, GL_DYNAMIC_DRAW);
+
+    glGenBuffers(1, &strandInstanceBuffer);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, strandInstanceBuffer);
+    glBufferData(GL_SHADER_STORAGE_BUFFER, strandInstances.size() * sizeof(GLuint), strandInstances.data(), GL_STATIC_DRAW);
+
+    glGenBuffers(1, &colliderBuffer);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, colliderBuffer);
+    glBufferData(GL_SHADER_STORAGE_BUFFER, colliders.size() * sizeof(glm::mat4), nullptr, GL_DYNAMIC_DRAW);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, GL_NONE);
+
+    strandFirsts.resize(strandCount);
+    strandCounts.assign(strandCount, particlesPerStrand);
+    for (uint32_t i = 0; i < strandCount; ++i)
+    {
+        strandFirsts[i] = i * particlesPerStrand;
+    }
+
+    glGenVertexArrays(1, &vao);
+    glBindVertexArray(vao);
+    glBindBuffer(GL_ARRAY_BUFFER, positionBuffer);
+    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 0, 0);
+    glEnableVertexAttribArray(0);
+    glBindVertexArray(GL_NONE);
+    glBindBuffer(GL_ARRAY_BUFFER, GL_NONE);
+}
+
+inline void HairBatch::updateInstances()
+{
+    for (uint32_t i = 0; i < hairs.size(); ++i)
+    {
+        HairInstanceData& instance = instances[i];
+        instance.model = hairs[i]->getTransformMatrix();
+        instance.wind = parameters[i].wind;
+        instance.gravity = parameters[i].gravity;
+        instance.frictionCoefficient = parameters[i].frictionCoefficient;
+        instance.velocityDampingCoefficient = parameters[i].velocityDampingCoefficient;
+
+        // Inverses are computed once per collider here instead of once per particle in the shader
+        const std::vector<glm::mat4> transforms = hairs[i]->getColliderTransforms();
+        for (uint32_t j = 0; j < instance.colliderCount; ++j)
+        {
+            colliders[(instance.colliderOffset + j) * 2] = transforms[j];
+            colliders[(instance.colliderOffset + j) * 2 + 1] = glm::inverse(transforms[j]);
+        }
+    }
+
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, instanceBuffer);
+    glBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, instances.size() * sizeof(HairInstanceData), instances.data());
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, colliderBuffer);
+    glBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, colliders.size() * sizeof(glm::mat4), colliders.data());
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, GL_NONE);
+}
+
+inline void HairBatch::applyPhysics(float deltaTime, float runningTime)
+{
+    if (strandCount == 0)
+        return;
+
+    updateInstances();
+
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, positionBuffer);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 1, velocityBuffer);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 2, volumeDensities);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 3, volumeVelocities);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 9, instanceBuffer);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 10, strandInstanceBuffer);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 11, colliderBuffer);
+
+    const GLint zero = 0;
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, volumeDensities);
+    glClearBufferData(GL_SHADER_STORAGE_BUFFER, GL_R32I, GL_RED_INTEGER, GL_INT, &zero);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, volumeVelocities);
+    glClearBufferData(GL_SHADER_STORAGE_BUFFER, GL_R32I, GL_RED_INTEGER, GL_INT, &zero);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, GL_NONE);
+    glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+
+    windField.update(runningTime);
+    windField.bind(0);
+
+    computeShader.use();
+    computeShader.setFloat("deltaTime", deltaTime);
+    computeShader.setFloat("runningTime", runningTime);
+
+    const GLuint localWorkGroupCountX = computeShader.getLocalWorkGroupsCount().x;
+    computeShader.setUint("state", 0);
+    computeShader.setGlobalWorkGroupCount((strandCount + localWorkGroupCountX - 1) / localWorkGroupCountX);
+    computeShader.dispatch();
+    glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+
+    const uint32_t particleCount = strandCount * particlesPerStrand;
+    computeShader.setGlobalWorkGroupCount((particleCount + localWorkGroupCountX - 1) / localWorkGroupCountX);
+    computeShader.setUint("state", 1);
+    computeShader.dispatch();
+    glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+
+    computeShader.setUint("state", 2);
+    computeShader.dispatch();
+
+    if (collisionsEnabled)
+    {
+        glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+        if (profiler) profiler->begin("Hair collision");
+        collision.resolve(glm::mat4(1.f), particleCount, particlesPerStrand, deltaTime);
+        if (profiler) profiler->end("Hair collision");
+    }
+}
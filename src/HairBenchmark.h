@@ -0,0 +1,542 @@
+#pragma once
+#include "Camera.h"
+#include "ComputeShader.h"
+#include "DrawingShader.h"
+#include "Hair.h"
+#include "HairTransparency.h"
+#include "MeshOptimizer.h"
+#include "ObjParser.h"
+#include "ScalpSampler.h"
+#include "OBJ_Loader.h"
+#include "TessellationShader.h"
+#include <chrono>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <string>
+#include <tuple>
+#include <vector>
+
+// Offline measurements of solver variants, run with --benchmark <name> instead of the interactive loop.
+// Simulations step with a fixed time step, so two variants started from the same state can be compared.
+class HairBenchmark {
+public:
+	static constexpr float FIXED_DELTA_TIME = 1.f / 60.f;
+	static constexpr uint32_t WARM_UP_FRAMES = 240;
+	static constexpr uint32_t MEASURED_FRAMES = 500;
+	static constexpr uint32_t OBJ_GRID_SIZE = 1582;		// Quads per side of the generated mesh, about 5M triangles
+
+	static bool run(const std::string& name) {
+        if (name == "precision")
+        {
+            runPrecisionBenchmark();
+            return true;
+        }
+        if (name == "integrator")
+        {
+            runIntegratorBenchmark();
+            return true;
+        }
+        if (name == "draw")
+        {
+            runDrawBenchmark();
+            return true;
+        }
+        if (name == "vertex")
+        {
+            runVertexBenchmark();
+            return true;
+        }
+        if (name == "transparency")
+        {
+            runTransparencyBenchmark();
+            return true;
+        }
+        if (name == "curves")
+        {
+            runCurvesBenchmark();
+            return true;
+        }
+        if (name == "compact")
+        {
+            runCompactBenchmark();
+            return true;
+        }
+        if (name == "scalp")
+        {
+            runScalpBenchmark();
+            return true;
+        }
+        if (name == "shaders")
+        {
+            runShaderBenchmark();
+            return true;
+        }
+        if (name == "obj")
+        {
+            runObjBenchmark();
+            return true;
+        }
+
+        std::cout << "Unknown benchmark '" << name << "', available: precision, integrator, draw, vertex, transparency, curves, compact, scalp, shaders, obj" << std::endl;
+        return false;
+    }
+
+	// Average GPU time of one call in milliseconds
+	static double measureGpuTime(const std::function<void(uint32_t)>& step, uint32_t frameCount) {
+        GLuint query;
+        glGenQueries(1, &query);
+        double totalTime = 0.0;
+        for (uint32_t i = 0; i < frameCount; ++i)
+        {
+            glBeginQuery(GL_TIME_ELAPSED, query);
+            step(i);
+            glEndQuery(GL_TIME_ELAPSED);
+            GLuint64 elapsed;
+            glGetQueryObjectui64v(query, GL_QUERY_RESULT, &elapsed);
+            totalTime += elapsed / 1e6;
+        }
+        glDeleteQueries(1, &query);
+        return totalTime / frameCount;
+    }
+
+	struct DrawTiming {
+		double cpuTime = 0.0;		// Time spent submitting the draw, in milliseconds
+		double gpuTime = 0.0;
+	};
+
+	static DrawTiming measureDrawTime(const std::function<void()>& draw, uint32_t frameCount) {
+        DrawTiming timing;
+        GLuint query;
+        glGenQueries(1, &query);
+        for (uint32_t i = 0; i < frameCount; ++i)
+        {
+            glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+            glFinish();
+            glBeginQuery(GL_TIME_ELAPSED, query);
+            const auto start = std::chrono::steady_clock::now();
+            draw();
+            timing.cpuTime += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+            glEndQuery(GL_TIME_ELAPSED);
+            GLuint64 elapsed;
+            glGetQueryObjectui64v(query, GL_QUERY_RESULT, &elapsed);
+            timing.gpuTime += elapsed / 1e6;
+        }
+        glDeleteQueries(1, &query);
+        timing.cpuTime /= frameCount;
+        timing.gpuTime /= frameCount;
+        return timing;
+    }
+
+	// Sets up the hair shader the way the interactive loop does, with the default camera
+	static void useHairShader(const Shader& shader, const Hair& hair) {
+        PerspectiveCamera camera;
+        camera.setProjectionAspectRatio(1440.f / 810);
+        camera.setPosition(glm::vec3(-3.5f, 2.f, 3.5f));
+        camera.setCenter(glm::vec3(0.f));
+        camera.setProjectionViewingAngle(100.f);
+        shader.use();
+        shader.setMat4("projection", camera.getProjection());
+        shader.setMat4("view", camera.getView());
+        shader.setMat4("model", hair.getTransformMatrix());
+        shader.setUint("particlesPerStrand", hair.getParticlesPerStrand());
+    }
+
+	static std::vector<glm::vec3> readPositions(const Hair& hair) {
+        std::vector<glm::vec3> positions(hair.getStrandCount() * hair.getParticlesPerStrand());
+        glMemoryBarrier(GL_BUFFER_UPDATE_BARRIER_BIT);
+        glBindBuffer(GL_COPY_READ_BUFFER, hair.getPositionBuffer());
+        glGetBufferSubData(GL_COPY_READ_BUFFER, 0, positions.size() * sizeof(glm::vec3), positions.data());
+        glBindBuffer(GL_COPY_READ_BUFFER, GL_NONE);
+        return positions;
+    }
+
+	static void copyPositions(const Hair& source, Hair& destination) {
+        glBindBuffer(GL_COPY_READ_BUFFER, source.getPositionBuffer());
+        glBindBuffer(GL_COPY_WRITE_BUFFER, destination.getPositionBuffer());
+        glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, 0, 0, source.getStrandCount() * source.getParticlesPerStrand() * sizeof(glm::vec3));
+        glBindBuffer(GL_COPY_READ_BUFFER, GL_NONE);
+        glBindBuffer(GL_COPY_WRITE_BUFFER, GL_NONE);
+    }
+
+	static void printPositionError(const std::vector<glm::vec3>& reference, const std::vector<glm::vec3>& positions) {
+        double squaredErrorSum = 0.0;
+        float maxError = 0.f;
+        for (size_t i = 0; i < reference.size(); ++i)
+        {
+            const float error = glm::distance(reference[i], positions[i]);
+            squaredErrorSum += error * error;
+            maxError = std::max(maxError, error);
+        }
+
+        const float segmentLength = HAIR_LENGTH / (PARTICLE_PER_HAIR - 1);
+        std::cout << "  position error after " << WARM_UP_FRAMES << " frames: rms " << std::sqrt(squaredErrorSum / reference.size())
+            << ", max " << maxError << " (" << maxError / segmentLength * 100.f << "% of a segment)" << std::endl;
+    }
+
+private:
+	static void runPrecisionBenchmark() {
+        HairOptions halfOptions;
+        halfOptions.halfPrecisionVelocities = true;
+        Hair reference(MAX_HAIR_COUNT);
+        halfOptions.scalpRoots = reference.getScalpRoots();
+        Hair half(MAX_HAIR_COUNT, halfOptions);
+        reference.setCollisionsEnabled(false);
+        half.setCollisionsEnabled(false);
+        copyPositions(reference, half);
+
+        std::cout << "Half precision velocities, " << MAX_HAIR_COUNT << " strands x " << PARTICLE_PER_HAIR << " particles" << std::endl;
+        for (uint32_t i = 0; i < WARM_UP_FRAMES; ++i)
+        {
+            reference.applyPhysics(FIXED_DELTA_TIME, i * FIXED_DELTA_TIME);
+            half.applyPhysics(FIXED_DELTA_TIME, i * FIXED_DELTA_TIME);
+        }
+        printPositionError(readPositions(reference), readPositions(half));
+
+        const double particleCount = MAX_HAIR_COUNT * PARTICLE_PER_HAIR;
+        for (Hair* hair : { &reference, &half })
+        {
+            const bool isHalf = hair->getOptions().halfPrecisionVelocities;
+            const double time = measureGpuTime([hair](uint32_t frame) {
+                hair->applyPhysics(FIXED_DELTA_TIME, (WARM_UP_FRAMES + frame) * FIXED_DELTA_TIME);
+            }, MEASURED_FRAMES);
+
+            // Velocities are read and written by the solver and friction passes and read by the splat pass,
+            // the gather reads 8 grid vertices per particle
+            const double velocityBytes = particleCount * 5 * (isHalf ? 8 : 12);
+            const double gridBytes = particleCount * 8 * (isHalf ? 8 : 16);
+            std::cout << "  " << (isHalf ? "fp16" : "fp32") << ": " << time << " ms per step, velocity buffer "
+                << particleCount * (isHalf ? 8 : 12) / (1024 * 1024) << " MiB, velocity and grid traffic "
+                << (velocityBytes + gridBytes) / (1024 * 1024) << " MiB per step" << std::endl;
+        }
+    }
+
+	static void runIntegratorBenchmark() {
+        HairOptions verlet;
+        verlet.verletIntegration = true;
+        HairOptions verletHalf = verlet;
+        verletHalf.halfPrecisionVelocities = true;
+
+        std::cout << "Integrators, " << MAX_HAIR_COUNT << " strands x " << PARTICLE_PER_HAIR << " particles" << std::endl;
+        const std::pair<const char*, HairOptions> variants[] = { { "Heun fp32", HairOptions() }, { "Verlet fp32", verlet }, { "Verlet fp16", verletHalf } };
+        std::shared_ptr<const std::vector<glm::vec3>> scalpRoots;		// Sampled by the first variant
+        for (const auto& variant : variants)
+        {
+            HairOptions options = variant.second;
+            options.scalpRoots = scalpRoots;
+            Hair hair(MAX_HAIR_COUNT, options);
+            scalpRoots = hair.getScalpRoots();
+            hair.setCollisionsEnabled(false);
+            for (uint32_t i = 0; i < WARM_UP_FRAMES; ++i)
+            {
+                hair.applyPhysics(FIXED_DELTA_TIME, i * FIXED_DELTA_TIME);
+            }
+
+            const double time = measureGpuTime([&hair](uint32_t frame) {
+                hair.applyPhysics(FIXED_DELTA_TIME, (WARM_UP_FRAMES + frame) * FIXED_DELTA_TIME);
+            }, MEASURED_FRAMES);
+
+            // Position plus the per particle integration state (velocity or displacement)
+            const uint32_t stateBytes = variant.second.halfPrecisionVelocities ? 8 : 12;
+            const double particleCount = MAX_HAIR_COUNT * PARTICLE_PER_HAIR;
+            std::cout << "  " << variant.first << ": " << time << " ms per step, " << 12 + stateBytes << " bytes per particle, "
+                << particleCount * (12 + stateBytes) / (1024 * 1024) << " MiB particle memory, "
+                << particleCount / (time * 1e3) << " M particles/s" << std::endl;
+        }
+    }
+
+	static void runDrawBenchmark() {
+        Hair hair(MAX_HAIR_COUNT);
+        DrawingShader shader("HairVertexShader.glsl", "HairGeometryShader.glsl", "HairFragmentShader.glsl");
+        useHairShader(shader, hair);
+
+        // Vertex array of the old submission path, one glDrawArrays per strand
+        GLuint perStrandVao;
+        glGenVertexArrays(1, &perStrandVao);
+        glBindVertexArray(perStrandVao);
+        glBindBuffer(GL_ARRAY_BUFFER, hair.getPositionBuffer());
+        glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 0, 0);
+        glEnableVertexAttribArray(0);
+        glBindVertexArray(GL_NONE);
+        glBindBuffer(GL_ARRAY_BUFFER, GL_NONE);
+
+        std::cout << "Hair submission" << std::endl;
+        for (uint32_t strandCount : { 2000U, MAX_HAIR_COUNT })
+        {
+            hair.setStrandCount(strandCount);
+            const DrawTiming perStrand = measureDrawTime([perStrandVao, strandCount]() {
+                glBindVertexArray(perStrandVao);
+                for (uint32_t i = 0; i < strandCount; ++i)
+                {
+                    glDrawArrays(GL_LINE_STRIP, i * PARTICLE_PER_HAIR, PARTICLE_PER_HAIR);
+                }
+                glBindVertexArray(GL_NONE);
+            }, MEASURED_FRAMES);
+            const DrawTiming multiDraw = measureDrawTime([&hair]() { hair.draw(); }, MEASURED_FRAMES);
+
+            std::cout << "  " << strandCount << " strands, per strand: " << strandCount << " draw calls, " << perStrand.cpuTime << " ms CPU, "
+                << perStrand.gpuTime << " ms GPU" << std::endl;
+            std::cout << "  " << strandCount << " strands, multi draw: 1 draw call, " << multiDraw.cpuTime << " ms CPU, "
+                << multiDraw.gpuTime << " ms GPU" << std::endl;
+        }
+
+        glDeleteVertexArrays(1, &perStrandVao);
+    }
+
+	static void runVertexBenchmark() {
+        Hair hair(MAX_HAIR_COUNT);
+        for (uint32_t i = 0; i < WARM_UP_FRAMES; ++i)
+        {
+            hair.applyPhysics(FIXED_DELTA_TIME, i * FIXED_DELTA_TIME);
+        }
+
+        std::cout << "Hair vertex processing, " << MAX_HAIR_COUNT << " strands x " << PARTICLE_PER_HAIR << " particles" << std::endl;
+        const DrawingShader geometryShader("HairVertexShader.glsl", "HairGeometryShader.glsl", "HairFragmentShader.glsl");
+        const DrawingShader pullingShader("HairStrandVertexShader.glsl", "HairFragmentShader.glsl");
+        const std::pair<const char*, const DrawingShader*> variants[] = { { "geometry shader", &geometryShader }, { "vertex pulling", &pullingShader } };
+        for (const auto& variant : variants)
+        {
+            useHairShader(*variant.second, hair);
+            const DrawTiming timing = measureDrawTime([&hair]() { hair.draw(); }, MEASURED_FRAMES);
+            std::cout << "  " << variant.first << ": " << timing.gpuTime << " ms GPU, " << timing.cpuTime << " ms CPU" << std::endl;
+        }
+    }
+
+	static void runTransparencyBenchmark() {
+        Hair hair(MAX_HAIR_COUNT);
+        for (uint32_t i = 0; i < WARM_UP_FRAMES; ++i)
+        {
+            hair.applyPhysics(FIXED_DELTA_TIME, i * FIXED_DELTA_TIME);
+        }
+
+        GLint viewport[4];
+        glGetIntegerv(GL_VIEWPORT, viewport);
+        std::cout << "Hair transparency, " << MAX_HAIR_COUNT << " strands at " << viewport[2] << "x" << viewport[3] << std::endl;
+        const std::pair<const char*, TransparencyMode> modes[] = { { "opaque", TransparencyMode::Opaque },
+            { "weighted blended", TransparencyMode::WeightedBlended }, { "linked list", TransparencyMode::LinkedList } };
+        for (const auto& mode : modes)
+        {
+            HairTransparency transparency(mode.second, glm::ivec2(viewport[2], viewport[3]));
+            const DrawingShader shader("HairStrandVertexShader.glsl", "HairFragmentShader.glsl", HairTransparency::getDefines(mode.second));
+            useHairShader(shader, hair);
+            transparency.apply(shader);
+
+            // Geometry pass and resolve together, the resolve switches programs so the hair shader is bound every frame
+            const DrawTiming timing = measureDrawTime([&]() {
+                shader.use();
+                transparency.begin();
+                hair.draw();
+                transparency.end();
+            }, MEASURED_FRAMES);
+            std::cout << "  " << mode.first << ": " << timing.gpuTime << " ms GPU, " << timing.cpuTime << " ms CPU" << std::endl;
+        }
+    }
+
+	static void runCurvesBenchmark() {
+        HairOptions fewParticles;
+        fewParticles.particlesPerStrand = 9;
+        Hair lines(MAX_HAIR_COUNT);
+        fewParticles.scalpRoots = lines.getScalpRoots();
+        Hair curves(MAX_HAIR_COUNT, fewParticles);
+        lines.setCollisionsEnabled(false);
+        curves.setCollisionsEnabled(false);
+        curves.setCurvesEnabled(true);
+        const DrawingShader lineShader("HairStrandVertexShader.glsl", "HairFragmentShader.glsl");
+        const TessellationShader curveShader("HairStrandVertexShader.glsl", "HairTessControlShader.glsl", "HairTessEvaluationShader.glsl",
+            "HairFragmentShader.glsl");
+
+        GLint viewport[4];
+        glGetIntegerv(GL_VIEWPORT, viewport);
+        std::cout << "Strand curves, " << MAX_HAIR_COUNT << " strands" << std::endl;
+        const std::tuple<const char*, Hair*, const Shader*> variants[] = { { "lines", &lines, &lineShader }, { "curves", &curves, &curveShader } };
+        for (const auto& [variantName, hair, shader] : variants)
+        {
+            for (uint32_t i = 0; i < WARM_UP_FRAMES; ++i)
+            {
+                hair->applyPhysics(FIXED_DELTA_TIME, i * FIXED_DELTA_TIME);
+            }
+            const double simulationTime = measureGpuTime([hair = hair](uint32_t frame) {
+                hair->applyPhysics(FIXED_DELTA_TIME, (WARM_UP_FRAMES + frame) * FIXED_DELTA_TIME);
+            }, MEASURED_FRAMES);
+
+            useHairShader(*shader, *hair);
+            shader->setVec2("viewportSize", glm::vec2(viewport[2], viewport[3]));
+            const DrawTiming drawTiming = measureDrawTime([hair = hair]() { hair->draw(); }, MEASURED_FRAMES);
+            std::cout << "  " << variantName << ", " << hair->getParticlesPerStrand() << " particles: " << simulationTime << " ms per step, "
+                << drawTiming.gpuTime << " ms GPU draw" << std::endl;
+        }
+    }
+
+	static void runCompactBenchmark() {
+        HairOptions compactOptions;
+        compactOptions.compactPositions = true;
+        Hair full(MAX_HAIR_COUNT);
+        compactOptions.scalpRoots = full.getScalpRoots();
+        Hair compact(MAX_HAIR_COUNT, compactOptions);
+        const DrawingShader fullShader("HairStrandVertexShader.glsl", "HairFragmentShader.glsl");
+        const DrawingShader compactShader("HairStrandVertexShader.glsl", "HairFragmentShader.glsl", std::vector<std::string>{ "COMPACT_POSITIONS" });
+
+        std::cout << "Compact positions, " << MAX_HAIR_COUNT << " strands x " << PARTICLE_PER_HAIR << " particles" << std::endl;
+        const std::tuple<const char*, Hair*, const DrawingShader*> variants[] = { { "fp32 positions", &full, &fullShader },
+            { "root + directions", &compact, &compactShader } };
+        for (const auto& [variantName, hair, shader] : variants)
+        {
+            for (uint32_t i = 0; i < WARM_UP_FRAMES; ++i)
+            {
+                hair->applyPhysics(FIXED_DELTA_TIME, i * FIXED_DELTA_TIME);
+            }
+            const double simulationTime = measureGpuTime([hair = hair](uint32_t frame) {
+                hair->applyPhysics(FIXED_DELTA_TIME, (WARM_UP_FRAMES + frame) * FIXED_DELTA_TIME);
+            }, MEASURED_FRAMES);
+
+            useHairShader(*shader, *hair);
+            const DrawTiming drawTiming = measureDrawTime([hair = hair]() { hair->draw(); }, MEASURED_FRAMES);
+
+            // Compact positions keep a packed direction per particle plus a float root per strand, and the full
+            // positions they are decoded into once per step
+            const double fullBytes = MAX_HAIR_COUNT * PARTICLE_PER_HAIR * sizeof(glm::vec3);
+            const double positionBytes = hair->getOptions().compactPositions ?
+                MAX_HAIR_COUNT * (PARTICLE_PER_HAIR * sizeof(uint32_t) + sizeof(glm::vec3)) : fullBytes;
+            std::cout << "  " << variantName << ": " << positionBytes / (1024 * 1024) << " MiB positions";
+            if (hair->getOptions().compactPositions)
+                std::cout << " + " << fullBytes / (1024 * 1024) << " MiB decoded";
+            std::cout << ", " << simulationTime << " ms per step, " << drawTiming.gpuTime << " ms GPU draw" << std::endl;
+        }
+    }
+
+	static void runScalpBenchmark() {
+        ObjMesh mesh;
+        if (!ObjParser::parse(TEXTURE_FOLDER + "FemaleHead/FemaleHead.obj", mesh))
+        {
+            std::cout << "Failed to load the head" << std::endl;
+            return;
+        }
+        const glm::mat4 headTransform = Hair::getHeadTransform();
+        std::vector<glm::vec3> positions(mesh.getVertexCount());
+        for (uint32_t i = 0; i < mesh.getVertexCount(); ++i)
+        {
+            positions[i] = glm::vec3(headTransform * glm::vec4(mesh.vertices[i * HEAD_FLOATS_PER_VERTEX], mesh.vertices[i * HEAD_FLOATS_PER_VERTEX + 1],
+                mesh.vertices[i * HEAD_FLOATS_PER_VERTEX + 2], 1.f));
+        }
+
+        auto start = std::chrono::steady_clock::now();
+        ScalpSampler sampler(positions, mesh.indices, &Hair::getScalpDensity);
+        std::cout << "Scalp root sampling with " << std::max(1U, std::thread::hardware_concurrency()) << " threads, " << sampler.getArea()
+            << " units of scalp, setup " << std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count() << " ms" << std::endl;
+        for (uint32_t rootCount : { 30000U, 100000U, 300000U, 1000000U })
+        {
+            start = std::chrono::steady_clock::now();
+            const std::vector<glm::vec3> roots = sampler.sample(rootCount);
+            const double time = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+            std::cout << "  " << roots.size() << " roots: " << time << " ms, " << roots.size() / (time * 1e3) << " M roots/s, "
+                << sampler.getRadius() << " apart" << std::endl;
+        }
+    }
+
+	static void runShaderBenchmark() {
+        // The solver variants and the hair drawing variants the command line options select between
+        const std::vector<std::vector<std::string>> solverVariants = { {}, { "HALF_VELOCITIES" }, { "VERLET_INTEGRATION" },
+            { "HALF_VELOCITIES", "VERLET_INTEGRATION" }, { "COMPACT_POSITIONS", "STRAND_SEGMENT_LENGTHS" } };
+        std::vector<std::vector<std::string>> drawVariants = { {}, { "SELF_SHADOWING" }, { "SELF_SHADOWING", "STRAND_LOD" }, { "COMPACT_POSITIONS" } };
+        for (TransparencyMode mode : { TransparencyMode::WeightedBlended, TransparencyMode::LinkedList })
+        {
+            drawVariants.push_back(HairTransparency::getDefines(mode));
+            drawVariants.back().push_back("SELF_SHADOWING");
+        }
+        const auto buildVariants = [&]() {
+            const auto start = std::chrono::steady_clock::now();
+            for (const auto& defines : solverVariants)
+            {
+                const ComputeShader solver("HairComputeShader.glsl", defines);
+                const ComputeShader collision("HairCollisionShader.glsl", defines);
+            }
+            for (const auto& defines : drawVariants)
+            {
+                const DrawingShader hairShader("HairStrandVertexShader.glsl", "HairFragmentShader.glsl", defines);
+            }
+            glFinish();
+            return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+        };
+
+        const uint32_t programCount = static_cast<uint32_t>(2 * solverVariants.size() + drawVariants.size());
+        std::cout << "Shader program builds, " << programCount << " programs" << std::endl;
+        ProgramCache::setEnabled(false);
+        const double compileTime = buildVariants();
+        ProgramCache::setEnabled(true);
+        const uint32_t loadedBefore = ProgramCache::getLoadedCount();
+        const double storeTime = buildVariants();
+        const uint32_t loadedBetween = ProgramCache::getLoadedCount();
+        const double loadTime = buildVariants();
+        std::cout << "  compiled: " << compileTime << " ms" << std::endl;
+        std::cout << "  compiled or loaded and cached: " << storeTime << " ms, " << loadedBetween - loadedBefore << " loaded" << std::endl;
+        std::cout << "  from the cache: " << loadTime << " ms, " << ProgramCache::getLoadedCount() - loadedBetween << " loaded ("
+            << compileTime / loadTime << "x)" << std::endl;
+    }
+
+	static void runObjBenchmark() {
+        const std::string gridPath = (std::filesystem::temp_directory_path() / "HairSimulationGrid.obj").string();
+        writeGridObj(gridPath, OBJ_GRID_SIZE);
+
+        std::cout << "OBJ loading, objl::Loader against ObjParser with " << std::max(1U, std::thread::hardware_concurrency()) << " threads" << std::endl;
+        for (const std::string& path : { TEXTURE_FOLDER + "FemaleHead/FemaleHead.obj", gridPath })
+        {
+            auto start = std::chrono::steady_clock::now();
+            objl::Loader loader;
+            const bool objlLoaded = loader.LoadFile(path);
+            const double objlTime = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+            start = std::chrono::steady_clock::now();
+            ObjMesh mesh;
+            const bool parsed = ObjParser::parse(path, mesh);
+            const double parserTime = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+            if (!objlLoaded || !parsed)
+            {
+                std::cout << "  failed to load " << path << std::endl;
+                continue;
+            }
+            std::cout << "  " << std::filesystem::path(path).filename().string() << ", " << mesh.indices.size() / 3 << " triangles: objl "
+                << objlTime << " ms, ObjParser " << parserTime << " ms (" << objlTime / parserTime << "x), "
+                << loader.LoadedVertices.size() << " against " << mesh.getVertexCount() << " vertices" << std::endl;
+        }
+        std::remove(gridPath.c_str());
+
+        // The application reorders the head once, when it builds the head mesh cache
+        ObjMesh head;
+        if (ObjParser::parse(TEXTURE_FOLDER + "FemaleHead/FemaleHead.obj", head))
+        {
+            std::vector<glm::vec3> positions(head.getVertexCount());
+            for (uint32_t i = 0; i < head.getVertexCount(); ++i)
+            {
+                positions[i] = glm::vec3(head.vertices[i * 6], head.vertices[i * 6 + 1], head.vertices[i * 6 + 2]);
+            }
+            std::vector<uint32_t> indices = MeshOptimizer::optimizeVertexCache(head.indices, head.getVertexCount());
+            indices = MeshOptimizer::optimizeOverdraw(indices, positions);
+            std::cout << "  head ACMR " << MeshOptimizer::computeAcmr(head.indices) << " -> " << MeshOptimizer::computeAcmr(indices) << std::endl;
+        }
+    }
+
+	// Flat grid of quads split into triangles, with a single shared normal
+	static void writeGridObj(const std::string& path, uint32_t size) {
+        std::ofstream stream(path);
+        for (uint32_t y = 0; y <= size; ++y)
+        {
+            for (uint32_t x = 0; x <= size; ++x)
+            {
+                stream << "v " << x / static_cast<float>(size) << ' ' << y / static_cast<float>(size) << " 0\n";
+            }
+        }
+        stream << "vn 0 0 1\n";
+        for (uint32_t y = 0; y < size; ++y)
+        {
+            for (uint32_t x = 0; x < size; ++x)
+            {
+                const uint32_t corner = y * (size + 1) + x + 1;
+                const uint32_t above = corner + size + 1;
+                stream << "f " << corner << "//1 " << corner + 1 << "//1 " << above << "//1\n";
+                stream << "f " << corner + 1 << "//1 " << above + 1 << "//1 " << above << "//1\n";
+            }
+        }
+    }
+};
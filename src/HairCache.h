@@ -0,0 +1,182 @@
+#pragma once
+#include "RansCoder.h"
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+const float HAIR_CACHE_QUANTIZATION_STEP = 1.f / 4096.f;	// Position precision of baked frames, in world units
+const uint32_t HAIR_CACHE_BLOCK_STRANDS = 4096U;			// Strands per independently coded block of a frame
+
+// File layout of baked strand positions: a header, the compressed blocks, and at the end an index with the offset
+// of every block, located through a footer, so any frame can be read without decoding the ones before it.
+//
+// A frame is split into blocks of consecutive strands that are compressed on their own, so the blocks of one frame
+// are encoded and decoded in parallel. Positions are quantized to integers, and every particle is predicted from
+// the ones before it on its strand: the root from the previous root of the block, the second particle from the root,
+// the others by extrapolating the last segment. The residuals are zigzag and varint coded to bytes, which are mostly
+// small, and the bytes of a block are entropy coded with their own rANS stream. Decoding restores the quantized
+// positions exactly. A frame the writer had to drop is recorded in the index as an empty entry.
+class HairCache {
+public:
+	static constexpr uint32_t MAGIC = 0x48434348U;			// "HCCH"
+	static constexpr uint32_t FOOTER_MAGIC = 0x58444E49U;	// "INDX"
+	static constexpr uint32_t VERSION = 2U;
+
+	struct Header {
+		uint32_t magic;
+		uint32_t version;
+		uint32_t particlesPerStrand;
+		float quantizationStep;
+	};
+
+	struct BlockHeader {
+		uint32_t firstStrand;
+		uint32_t strandCount;
+		uint32_t residualByteCount;		// Varint bytes before the entropy coding
+		uint32_t encodedByteCount;
+		RansCoder::Frequencies frequencies;
+	};
+
+	// One per block, in frame order
+	struct IndexEntry {
+		uint64_t offset;				// Of the block header, from the start of the file
+		uint32_t size;					// Block header and encoded bytes, 0 for a dropped frame
+		float time;						// Simulation time at which the frame was captured
+		uint32_t frame;
+		uint32_t padding;
+	};
+
+	struct Footer {
+		uint64_t indexOffset;
+		uint32_t frameCount;
+		uint32_t magic;
+	};
+
+	// Appends the block header and the encoded bytes of strandCount strands from firstStrand of the frame's positions
+	static void encodeBlock(const float* positions, uint32_t firstStrand, uint32_t strandCount, uint32_t particlesPerStrand,
+		float quantizationStep, std::vector<uint8_t>& residuals, std::vector<uint8_t>& output);
+	// Decodes a block written by encodeBlock into the positions of a frame of strandCapacity strands
+	static bool decodeBlock(const uint8_t* block, size_t blockSize, uint32_t particlesPerStrand, float quantizationStep,
+		std::vector<uint8_t>& residuals, float* positions, uint32_t strandCapacity);
+
+	// One past the last strand of the block
+	static uint32_t getStrandEnd(const uint8_t* block) {
+        BlockHeader blockHeader;
+        std::memcpy(&blockHeader, block, sizeof(BlockHeader));
+        return blockHeader.firstStrand + blockHeader.strandCount;
+    }
+
+private:
+	static int32_t quantize(float value, float inverseStep) {
+        const float scaled = value * inverseStep;
+        if (!(std::abs(scaled) < 2e9f))
+            return 0;
+        return static_cast<int32_t>(std::lround(scaled));
+    }
+	// History holds the quantized components of the last three particles of the strand, indexed by particle % 3.
+	// The arithmetic wraps around, encoder and decoder agree on it for any input.
+	static uint32_t predict(const uint32_t* history, const uint32_t* previousRoot, uint32_t particle, uint32_t component) {
+        if (particle == 0)
+            return previousRoot[component];
+        const uint32_t last = history[((particle + 2) % 3) * 3 + component];
+        if (particle == 1)
+            return last;
+        return 2 * last - history[((particle + 1) % 3) * 3 + component];
+    }
+};
+
+inline void HairCache::encodeBlock(const float* positions, uint32_t firstStrand, uint32_t strandCount, uint32_t particlesPerStrand,
+	float quantizationStep, std::vector<uint8_t>& residuals, std::vector<uint8_t>& output)
+{
+    const float inverseStep = 1.f / quantizationStep;
+    residuals.clear();
+    uint32_t previousRoot[3] = { 0, 0, 0 };
+    uint32_t history[3 * 3];
+    for (uint32_t strand = 0; strand < strandCount; ++strand)
+    {
+        const float* strandPositions = positions + (static_cast<size_t>(firstStrand) + strand) * particlesPerStrand * 3;
+        for (uint32_t particle = 0; particle < particlesPerStrand; ++particle)
+        {
+            for (uint32_t component = 0; component < 3; ++component)
+            {
+                const uint32_t value = static_cast<uint32_t>(quantize(strandPositions[particle * 3 + component], inverseStep));
+                const uint32_t residual = value - predict(history, previousRoot, particle, component);
+                history[(particle % 3) * 3 + component] = value;
+                if (particle == 0)
+                    previousRoot[component] = value;
+
+                // Zigzag maps small magnitudes of both signs to small codes, seven bits per varint byte
+                uint32_t code = (residual << 1) ^ static_cast<uint32_t>(static_cast<int32_t>(residual) >> 31);
+                while (code >= 0x80)
+                {
+                    residuals.push_back(static_cast<uint8_t>(code | 0x80));
+                    code >>= 7;
+                }
+                residuals.push_back(static_cast<uint8_t>(code));
+            }
+        }
+    }
+
+    BlockHeader blockHeader{};
+    blockHeader.firstStrand = firstStrand;
+    blockHeader.strandCount = strandCount;
+    blockHeader.residualByteCount = static_cast<uint32_t>(residuals.size());
+    if (!residuals.empty())
+        blockHeader.frequencies = RansCoder::normalize(residuals);
+    const size_t headerOffset = output.size();
+    output.resize(headerOffset + sizeof(BlockHeader));
+    if (!residuals.empty())
+        RansCoder::encode(residuals, blockHeader.frequencies, output);
+    blockHeader.encodedByteCount = static_cast<uint32_t>(output.size() - headerOffset - sizeof(BlockHeader));
+    std::memcpy(output.data() + headerOffset, &blockHeader, sizeof(BlockHeader));
+}
+
+inline bool HairCache::decodeBlock(const uint8_t* block, size_t blockSize, uint32_t particlesPerStrand, float quantizationStep,
+	std::vector<uint8_t>& residuals, float* positions, uint32_t strandCapacity)
+{
+    if (blockSize < sizeof(BlockHeader))
+        return false;
+    BlockHeader blockHeader;
+    std::memcpy(&blockHeader, block, sizeof(BlockHeader));
+    if (blockSize < sizeof(BlockHeader) + blockHeader.encodedByteCount || blockHeader.firstStrand > strandCapacity ||
+        blockHeader.strandCount > strandCapacity - blockHeader.firstStrand)
+        return false;
+
+    residuals.resize(blockHeader.residualByteCount);
+    if (!RansCoder::decode(block + sizeof(BlockHeader), blockHeader.encodedByteCount, blockHeader.frequencies,
+        residuals.data(), residuals.size()))
+        return false;
+
+    const uint8_t* cursor = residuals.data();
+    const uint8_t* end = cursor + residuals.size();
+    uint32_t previousRoot[3] = { 0, 0, 0 };
+    uint32_t history[3 * 3];
+    for (uint32_t strand = 0; strand < blockHeader.strandCount; ++strand)
+    {
+        float* strandPositions = positions + (static_cast<size_t>(blockHeader.firstStrand) + strand) * particlesPerStrand * 3;
+        for (uint32_t particle = 0; particle < particlesPerStrand; ++particle)
+        {
+            for (uint32_t component = 0; component < 3; ++component)
+            {
+                uint32_t code = 0;
+                for (uint32_t shift = 0; ; shift += 7)
+                {
+                    if (cursor == end || shift > 28)
+                        return false;
+                    code |= static_cast<uint32_t>(*cursor & 0x7F) << shift;
+                    if (!(*cursor++ & 0x80))
+                        break;
+                }
+                const uint32_t residual = (code >> 1) ^ (0U - (code & 1));
+
+                const uint32_t value = predict(history, previousRoot, particle, component) + residual;
+                history[(particle % 3) * 3 + component] = value;
+                if (particle == 0)
+                    previousRoot[component] = value;
+                strandPositions[particle * 3 + component] = static_cast<int32_t>(value) * quantizationStep;
+            }
+        }
+    }
+    return cursor == end;
+}
@@ -0,0 +1,277 @@
+#pragma once
+#include <glad/glad.h>
+#include "Hair.h"
+#include "HairCache.h"
+#include "MappedFile.h"
+#include <algorithm>
+#include <array>
+#include <condition_variable>
+#include <cstring>
+#include <iostream>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+const uint32_t HAIR_CACHE_UPLOAD_SLOTS = 4U;		// Decoded frames waiting for or being copied by the GPU
+const float HAIR_CACHE_SCRUB_SPEED = 4.f;			// Seconds of the cache per second while scrubbing
+
+// Plays a baked HairCache back into a hair's position buffer instead of running the solver. The file is memory
+// mapped, and a worker thread decodes the next frames straight into persistently mapped upload buffers ahead of
+// time. The GL thread only copies a ready buffer into the position buffer, so playing and scrubbing stay at display
+// rate. When a seek lands on a frame that isn't decoded yet, the last frame stays visible until it is.
+class HairCachePlayer {
+public:
+	explicit HairCachePlayer(const std::string& path) : file(path) {
+        if (!readIndex())
+        {
+            std::cout << "Failed to open the hair cache " << path << std::endl;
+            return;
+        }
+
+        uint32_t maxStrandCount = 0;
+        for (auto& frame : frames)
+        {
+            for (uint32_t block = frame.firstEntry; block < frame.firstEntry + frame.entryCount; ++block)
+            {
+                frame.strandCount = std::max(frame.strandCount, HairCache::getStrandEnd(file.getData() + index[block].offset));
+            }
+            maxStrandCount = std::max(maxStrandCount, frame.strandCount);
+        }
+        const GLsizeiptr frameBytes = std::max<GLsizeiptr>(1, static_cast<GLsizeiptr>(maxStrandCount) * header.particlesPerStrand * sizeof(glm::vec3));
+        const GLbitfield mapFlags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+        for (auto& slot : slots)
+        {
+            glCreateBuffers(1, &slot.uploadBuffer);
+            glNamedBufferStorage(slot.uploadBuffer, frameBytes, nullptr, mapFlags);
+            slot.positions = static_cast<float*>(glMapNamedBufferRange(slot.uploadBuffer, 0, frameBytes, mapFlags));
+        }
+        worker = std::thread(&HairCachePlayer::decodeFrames, this);
+        std::cout << "Playing " << frames.size() << " frames of " << maxStrandCount << " strands from " << path << std::endl;
+    }
+	~HairCachePlayer() {
+        if (worker.joinable())
+        {
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                stopping = true;
+            }
+            condition.notify_one();
+            worker.join();
+        }
+        for (auto& slot : slots)
+        {
+            if (slot.fence)
+                glDeleteSync(slot.fence);
+            if (slot.uploadBuffer)
+            {
+                glUnmapNamedBuffer(slot.uploadBuffer);
+                glDeleteBuffers(1, &slot.uploadBuffer);
+            }
+        }
+    }
+	HairCachePlayer(const HairCachePlayer&) = delete;
+	HairCachePlayer& operator=(const HairCachePlayer&) = delete;
+
+	bool isValid() const { return worker.joinable(); }
+	uint32_t getParticlesPerStrand() const { return header.particlesPerStrand; }
+	uint32_t getFrameCount() const { return static_cast<uint32_t>(frames.size()); }
+	float getDuration() const { return frames.empty() ? 0.f : frames.back().time - frames.front().time; }
+
+	void setPaused(bool _paused) { paused = _paused; }
+	bool isPaused() const { return paused; }
+	// Jumps to a time of the cache, from its first frame, which wraps around at the end
+	void seek(float time) {
+        const float duration = getDuration();
+        playbackTime = duration > 0.f ? time - duration * std::floor(time / duration) : 0.f;
+    }
+	// Moves the playback by a time, negative to go back, regardless of the pause
+	void scrub(float time) { seek(playbackTime + time); }
+
+	// Advances the playback and shows the frame of the current time once it has been decoded
+	void update(Hair& hair, float deltaTime);
+
+private:
+	// Blocks of the index that make up a frame
+	struct Frame {
+		float time = 0.f;
+		uint32_t firstEntry = 0;
+		uint32_t entryCount = 0;
+		uint32_t strandCount = 0;
+	};
+
+	enum class SlotState { Free, Decoding, Ready, Uploading };
+	struct Slot {
+		GLuint uploadBuffer = GL_NONE;
+		float* positions = nullptr;
+		SlotState state = SlotState::Free;
+		int64_t frame = -1;
+		uint32_t strandCount = 0;
+		GLsync fence = nullptr;			// Set while the GPU copies from the buffer
+	};
+
+	bool readIndex() {
+        if (!file.isValid() || file.getSize() < sizeof(HairCache::Header) + sizeof(HairCache::Footer))
+            return false;
+        std::memcpy(&header, file.getData(), sizeof(header));
+        HairCache::Footer footer;
+        std::memcpy(&footer, file.getData() + file.getSize() - sizeof(footer), sizeof(footer));
+        if (header.magic != HairCache::MAGIC || header.version != HairCache::VERSION || footer.magic != HairCache::FOOTER_MAGIC ||
+            footer.indexOffset + static_cast<uint64_t>(footer.frameCount) * sizeof(HairCache::IndexEntry) + sizeof(footer) != file.getSize() ||
+            footer.frameCount == 0)
+            return false;
+
+        index.resize(footer.frameCount);
+        std::memcpy(index.data(), file.getData() + footer.indexOffset, index.size() * sizeof(HairCache::IndexEntry));
+        // Consecutive blocks of the same frame are grouped, the empty entries of dropped frames are skipped
+        for (uint32_t entryIndex = 0; entryIndex < index.size(); ++entryIndex)
+        {
+            const auto& entry = index[entryIndex];
+            if (entry.size == 0)
+                continue;
+            if (entry.offset + entry.size > footer.indexOffset || entry.size < sizeof(HairCache::BlockHeader))
+                return false;
+            if (entryIndex == 0 || index[entryIndex - 1].frame != entry.frame || index[entryIndex - 1].size == 0)
+                frames.push_back({ entry.time, entryIndex, 0, 0 });
+            ++frames.back().entryCount;
+        }
+        return !frames.empty();
+    }
+
+	// Frame shown at the playback time, the last one captured at or before it
+	int64_t getFrameAt(float time) const {
+        const auto next = std::upper_bound(frames.begin(), frames.end(), frames.front().time + time,
+            [](float value, const Frame& frame) { return value < frame.time; });
+        return std::max<int64_t>(0, (next - frames.begin()) - 1);
+    }
+
+	// Decodes the frames from the current one on into free slots, and replaces decoded frames the playback has left
+	void decodeFrames();
+
+	MappedFile file;
+	HairCache::Header header{};
+	std::vector<HairCache::IndexEntry> index;
+	std::vector<Frame> frames;
+	float playbackTime = 0.f;
+	bool paused = false;
+
+	// Shared with the worker
+	std::thread worker;
+	std::mutex mutex;
+	std::condition_variable condition;
+	std::array<Slot, HAIR_CACHE_UPLOAD_SLOTS> slots;
+	int64_t currentFrame = 0;
+	int64_t shownFrame = -1;
+	bool stopping = false;
+};
+
+inline void HairCachePlayer::update(Hair& hair, float deltaTime)
+{
+    if (!isValid())
+        return;
+    if (!paused)
+        seek(playbackTime + deltaTime);
+    const int64_t frame = getFrameAt(playbackTime);
+
+    // Buffers the GPU has finished copying from go back to the worker
+    for (auto& slot : slots)
+    {
+        if (slot.fence && glClientWaitSync(slot.fence, 0, 0) != GL_TIMEOUT_EXPIRED)
+        {
+            glDeleteSync(slot.fence);
+            slot.fence = nullptr;
+            std::lock_guard<std::mutex> lock(mutex);
+            slot.state = SlotState::Free;
+        }
+    }
+
+    Slot* readySlot = nullptr;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        currentFrame = frame;
+        if (frame != shownFrame)
+        {
+            for (auto& slot : slots)
+            {
+                if (slot.state == SlotState::Ready && slot.frame == frame)
+                {
+                    slot.state = SlotState::Uploading;
+                    readySlot = &slot;
+                    shownFrame = frame;
+                }
+            }
+        }
+    }
+    condition.notify_one();
+    if (!readySlot)
+        return;
+
+    hair.setStrandCount(readySlot->strandCount);
+    glCopyNamedBufferSubData(readySlot->uploadBuffer, hair.getPositionBuffer(), 0, 0,
+        static_cast<GLsizeiptr>(hair.getStrandCount()) * header.particlesPerStrand * static_cast<GLsizeiptr>(sizeof(glm::vec3)));
+    readySlot->fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+}
+
+inline void HairCachePlayer::decodeFrames()
+{
+    std::vector<uint8_t> residuals;
+    const int64_t frameCount = static_cast<int64_t>(frames.size());
+    while (true)
+    {
+        Slot* target = nullptr;
+        int64_t frame = -1;
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            condition.wait(lock, [&]() {
+                if (stopping)
+                    return true;
+                // The frames worth decoding are the current one, unless it is already shown, and the ones after it,
+                // wrapping around, as many as there are slots minus the one the GPU may still be copying from. They are
+                // recomputed on every wake up, so a seek while waiting prefetches from the new frame on.
+                const int64_t firstAhead = currentFrame == shownFrame ? 1 : 0;
+                const int64_t lastAhead = std::min<int64_t>(firstAhead + HAIR_CACHE_UPLOAD_SLOTS - 1, frameCount);
+                const auto isAhead = [&](int64_t candidate) {
+                    const int64_t ahead = (candidate - currentFrame + frameCount) % frameCount;
+                    return ahead >= firstAhead && ahead < lastAhead;
+                };
+                for (int64_t ahead = firstAhead; ahead < lastAhead; ++ahead)
+                {
+                    const int64_t candidate = (currentFrame + ahead) % frameCount;
+                    const bool decoded = std::any_of(slots.begin(), slots.end(), [&](const Slot& slot) {
+                        return slot.frame == candidate && slot.state != SlotState::Free;
+                    });
+                    if (decoded)
+                        continue;
+                    for (auto& slot : slots)
+                    {
+                        if (slot.state == SlotState::Free || (slot.state == SlotState::Ready && !isAhead(slot.frame)))
+                        {
+                            target = &slot;
+                            frame = candidate;
+                            return true;
+                        }
+                    }
+                    return false;
+                }
+                return false;
+            });
+            if (stopping)
+                return;
+            target->state = SlotState::Decoding;
+            target->frame = frame;
+        }
+
+        const Frame& cachedFrame = frames[frame];
+        bool decoded = true;
+        for (uint32_t block = cachedFrame.firstEntry; decoded && block < cachedFrame.firstEntry + cachedFrame.entryCount; ++block)
+        {
+            decoded = HairCache::decodeBlock(file.getData() + index[block].offset, index[block].size, header.particlesPerStrand,
+                header.quantizationStep, residuals, target->positions, cachedFrame.strandCount);
+        }
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            target->strandCount = decoded ? cachedFrame.strandCount : 0;
+            target->state = SlotState::Ready;
+        }
+    }
+}
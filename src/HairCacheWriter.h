@@ -0,0 +1,264 @@
+#pragma once
+#include "BufferReadback.h"
+#include "Hair.h"
+#include "HairCache.h"
+#include <algorithm>
+#include <condition_variable>
+#include <deque>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+const uint32_t HAIR_CACHE_READBACK_COUNT = 3U;		// Frames copied ahead of the encoders
+const uint32_t HAIR_CACHE_MAX_ENCODERS = 4U;		// Blocks compressed at the same time, one thread each
+
+// Bakes the simulated strand positions of every frame into a HairCache file. The positions are copied into one of a
+// few staging buffers behind a fence, and once the copy has finished the frame is split into blocks of strands that
+// the encoder threads compress in parallel from the mapped memory. Frames are appended to the file in capture order,
+// so the simulation loop never waits for the GPU, the encoders or the disk. When all staging buffers are still in use
+// the frame is dropped instead, and recorded in the index so the player knows it is missing.
+class HairCacheWriter {
+public:
+	HairCacheWriter(const Hair& hair, const std::string& _path, float _quantizationStep = HAIR_CACHE_QUANTIZATION_STEP)
+    : path(_path), particlesPerStrand(hair.getParticlesPerStrand()), quantizationStep(_quantizationStep),
+    stream(_path, std::ios::binary | std::ios::trunc) {
+        if (!stream)
+        {
+            std::cout << "Failed to open the hair cache " << path << std::endl;
+            return;
+        }
+        const HairCache::Header header = { HairCache::MAGIC, HairCache::VERSION, particlesPerStrand, quantizationStep };
+        stream.write(reinterpret_cast<const char*>(&header), sizeof(header));
+        fileSize = sizeof(header);
+
+        const uint32_t encoderCount = std::min(HAIR_CACHE_MAX_ENCODERS, std::max(2U, std::thread::hardware_concurrency()) - 1);
+        const GLsizeiptr frameBytes = static_cast<GLsizeiptr>(MAX_HAIR_COUNT) * particlesPerStrand * sizeof(glm::vec3);
+        slots.resize(HAIR_CACHE_READBACK_COUNT + encoderCount);
+        for (auto& slot : slots)
+        {
+            slot.readback = std::make_unique<BufferReadback>(frameBytes);
+        }
+        for (uint32_t i = 0; i < encoderCount; ++i)
+        {
+            encoders.emplace_back(&HairCacheWriter::encodeBlocks, this);
+        }
+    }
+	~HairCacheWriter() {
+        if (encoders.empty())
+            return;
+
+        // Every frame that was read back still reaches the file
+        while (!readbackQueue.empty())
+        {
+            submitFinishedReadbacks(true);
+        }
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stopping = true;
+        }
+        workCondition.notify_all();
+        for (auto& encoder : encoders)
+        {
+            encoder.join();
+        }
+        // Frames dropped after the last encoded one
+        writeFinishedFrames();
+
+        const HairCache::Footer footer = { fileSize, static_cast<uint32_t>(index.size()), HairCache::FOOTER_MAGIC };
+        stream.write(reinterpret_cast<const char*>(index.data()), index.size() * sizeof(HairCache::IndexEntry));
+        stream.write(reinterpret_cast<const char*>(&footer), sizeof(footer));
+        stream.flush();
+        if (!stream)
+        {
+            std::cout << "Failed to write the hair cache " << path << ", the bake is incomplete" << std::endl;
+            return;
+        }
+        const double rawSize = static_cast<double>(rawBytes);
+        std::cout << "Baked " << capturedFrames - droppedFrames << " frames into " << path << ", " << fileSize / (1024.0 * 1024.0) << " MB, " <<
+            (fileSize > 0 ? rawSize / fileSize : 0.0) << "x smaller than raw positions";
+        if (droppedFrames > 0)
+            std::cout << ", " << droppedFrames << " frames were dropped because the encoders fell behind";
+        std::cout << std::endl;
+    }
+	HairCacheWriter(const HairCacheWriter&) = delete;
+	HairCacheWriter& operator=(const HairCacheWriter&) = delete;
+
+	// Queues the readback of the hair's current positions, called after the simulation step. Never waits, the frame is
+	// dropped when no staging buffer is free.
+	void capture(const Hair& hair, float time) {
+        if (encoders.empty())
+            return;
+        submitFinishedReadbacks(false);
+
+        const uint32_t frame = capturedFrames++;
+        const uint32_t strandCount = hair.getStrandCount();
+        uint32_t slotIndex;
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            if (!findFreeSlot(slotIndex))
+            {
+                if (droppedFrames++ == 0)
+                    std::cout << "The hair cache encoders fell behind, frames are dropped from the bake" << std::endl;
+                pendingFrames.push_back({ NO_SLOT, frame, time });
+                return;
+            }
+            Slot& slot = slots[slotIndex];
+            slot.busy = true;
+            slot.remainingBlocks = std::max(1U, (strandCount + HAIR_CACHE_BLOCK_STRANDS - 1) / HAIR_CACHE_BLOCK_STRANDS);
+            pendingFrames.push_back({ slotIndex, frame, time });
+        }
+
+        Slot& slot = slots[slotIndex];
+        slot.strandCount = strandCount;
+        slot.blocks.resize(slot.remainingBlocks);
+        slot.readback->request({ { hair.getPositionBuffer(), 0,
+            static_cast<GLsizeiptr>(strandCount) * particlesPerStrand * static_cast<GLsizeiptr>(sizeof(glm::vec3)) } });
+        readbackQueue.push_back(slotIndex);
+    }
+
+private:
+	static constexpr uint32_t NO_SLOT = ~0U;
+
+	struct Slot {
+		std::unique_ptr<BufferReadback> readback;
+		uint32_t strandCount = 0;
+		std::vector<std::vector<uint8_t>> blocks;	// Encoded bytes of every block of strands
+		uint32_t remainingBlocks = 0;
+		bool busy = false;							// From the readback request until the frame has been written
+	};
+
+	// Captured frame waiting to be written, in capture order
+	struct PendingFrame {
+		uint32_t slot;								// NO_SLOT when the frame was dropped
+		uint32_t frame;
+		float time;
+	};
+
+	struct BlockTask {
+		uint32_t slot;
+		uint32_t block;
+	};
+
+	// Called with the mutex held
+	bool findFreeSlot(uint32_t& slotIndex) const {
+        for (uint32_t i = 0; i < slots.size(); ++i)
+        {
+            if (!slots[i].busy)
+            {
+                slotIndex = i;
+                return true;
+            }
+        }
+        return false;
+    }
+
+	// Hands the blocks of the finished readbacks to the encoders in capture order, waiting for the oldest one when asked to
+	void submitFinishedReadbacks(bool wait) {
+        while (!readbackQueue.empty() && slots[readbackQueue.front()].readback->poll(wait))
+        {
+            const uint32_t slotIndex = readbackQueue.front();
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                for (uint32_t block = 0; block < slots[slotIndex].blocks.size(); ++block)
+                {
+                    encodeQueue.push_back({ slotIndex, block });
+                }
+            }
+            workCondition.notify_all();
+            readbackQueue.pop_front();
+            wait = false;
+        }
+    }
+
+	void encodeBlocks() {
+        std::vector<uint8_t> residuals;
+        while (true)
+        {
+            BlockTask task;
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                workCondition.wait(lock, [this]() { return stopping || !encodeQueue.empty(); });
+                if (encodeQueue.empty())
+                    return;
+                task = encodeQueue.front();
+                encodeQueue.pop_front();
+            }
+
+            Slot& slot = slots[task.slot];
+            const uint32_t firstStrand = task.block * HAIR_CACHE_BLOCK_STRANDS;
+            const uint32_t strandCount = std::min(HAIR_CACHE_BLOCK_STRANDS, slot.strandCount - std::min(slot.strandCount, firstStrand));
+            std::vector<uint8_t>& block = slot.blocks[task.block];
+            block.clear();
+            HairCache::encodeBlock(reinterpret_cast<const float*>(slot.readback->getData()), firstStrand, strandCount,
+                particlesPerStrand, quantizationStep, residuals, block);
+
+            // The encoder of the last block of a frame writes it, with the frames after it that are already done
+            bool frameEncoded;
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                frameEncoded = --slot.remainingBlocks == 0;
+            }
+            if (frameEncoded)
+                writeFinishedFrames();
+        }
+    }
+
+	// Appends the oldest pending frames to the file, as long as they are encoded or dropped
+	void writeFinishedFrames() {
+        std::lock_guard<std::mutex> writeLock(writeMutex);
+        while (true)
+        {
+            PendingFrame pending;
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                if (pendingFrames.empty() || (pendingFrames.front().slot != NO_SLOT && slots[pendingFrames.front().slot].remainingBlocks > 0))
+                    return;
+                pending = pendingFrames.front();
+                pendingFrames.pop_front();
+            }
+
+            if (pending.slot == NO_SLOT)
+            {
+                index.push_back({ fileSize, 0U, pending.time, pending.frame, 0U });
+                continue;
+            }
+            Slot& slot = slots[pending.slot];
+            for (const auto& block : slot.blocks)
+            {
+                stream.write(reinterpret_cast<const char*>(block.data()), block.size());
+                index.push_back({ fileSize, static_cast<uint32_t>(block.size()), pending.time, pending.frame, 0U });
+                fileSize += block.size();
+            }
+            rawBytes += static_cast<uint64_t>(slot.strandCount) * particlesPerStrand * sizeof(glm::vec3);
+            std::lock_guard<std::mutex> lock(mutex);
+            slot.busy = false;
+        }
+    }
+
+	std::string path;
+	uint32_t particlesPerStrand;
+	float quantizationStep;
+	std::ofstream stream;
+	std::deque<uint32_t> readbackQueue;			// Slots with copies in flight, oldest first
+	uint32_t capturedFrames = 0;
+
+	// Shared with the encoders
+	std::vector<Slot> slots;
+	std::vector<std::thread> encoders;
+	std::mutex mutex;
+	std::condition_variable workCondition;
+	std::deque<BlockTask> encodeQueue;
+	std::deque<PendingFrame> pendingFrames;
+	uint32_t droppedFrames = 0;
+	bool stopping = false;
+
+	// Only touched under the write mutex, by one encoder at a time until they have been joined
+	std::mutex writeMutex;
+	std::vector<HairCache::IndexEntry> index;
+	uint64_t fileSize = 0;
+	uint64_t rawBytes = 0;
+};
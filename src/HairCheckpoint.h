@@ -0,0 +1,185 @@
+#pragma once
+#include <glad/glad.h>
+#include "BufferReadback.h"
+#include "Hair.h"
+#include "MappedFile.h"
+#include <chrono>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <thread>
+
+// Snapshot of a hair's simulation state: positions and velocities of the simulated strands, the per strand segment
+// lengths of imported grooms and compact positions, the roots of compact positions, the parameters and the
+// transform. Saving copies the buffers into a staging buffer on the GPU and the file is written once the copy has
+// finished, by a thread that reads the mapped staging memory, so the simulation never waits for the readback or the
+// disk. Restoring uploads the whole payload at once.
+// The friction grid isn't part of the snapshot, the solver rebuilds it from the particles at every step.
+class HairCheckpoint {
+public:
+	static constexpr uint32_t MAGIC = 0x504B4348U;		// "HCKP"
+	static constexpr uint32_t VERSION = 1U;				// Increment when the layout changes
+
+	explicit HairCheckpoint(const Hair& hair) : readback(getMaximumPayloadSize(hair)) {}
+	~HairCheckpoint() {
+        // A snapshot that was requested still reaches the disk
+        if (readback.isPending() && readback.poll(true))
+            startWriting();
+        if (writer.joinable())
+            writer.join();
+    }
+	HairCheckpoint(const HairCheckpoint&) = delete;
+	HairCheckpoint& operator=(const HairCheckpoint&) = delete;
+
+	// Queues the copies of the hair's state, fails while the previous snapshot is still being read back
+	bool save(const Hair& hair, const std::string& _path) {
+        if (readback.isPending())
+            return false;
+        // The writer reads the staging memory that the new copies overwrite
+        if (writer.joinable())
+            writer.join();
+
+        header = makeHeader(hair);
+        path = _path;
+        const GLsizeiptr particleCount = static_cast<GLsizeiptr>(header.strandCount) * header.particlesPerStrand;
+        std::vector<BufferReadback::Range> ranges = {
+            { hair.getPositionBuffer(), 0, particleCount * static_cast<GLsizeiptr>(getPositionBytesPerParticle(header)) },
+            { hair.getVelocityBuffer(), 0, particleCount * header.velocityBytesPerParticle }
+        };
+        if (header.flags & SEGMENT_LENGTHS)
+            ranges.push_back({ hair.getSegmentLengthBuffer(), 0, static_cast<GLsizeiptr>(header.strandCount) * static_cast<GLsizeiptr>(sizeof(float)) });
+        if (header.flags & COMPACT_POSITIONS)
+            ranges.push_back({ hair.getRootBuffer(), 0, static_cast<GLsizeiptr>(header.strandCount) * static_cast<GLsizeiptr>(sizeof(glm::vec3)) });
+        return readback.request(ranges);
+    }
+
+	// Called once per frame, hands a finished readback to the writer
+	void update() {
+        if (readback.isPending() && readback.poll())
+            startWriting();
+    }
+
+	// Replaces the hair's state with the snapshot, fails when the file doesn't match the hair's layout
+	static bool restore(Hair& hair, const std::string& path);
+
+private:
+	static constexpr uint32_t HALF_VELOCITIES = 1U << 0;
+	static constexpr uint32_t VERLET_INTEGRATION = 1U << 1;
+	static constexpr uint32_t SEGMENT_LENGTHS = 1U << 2;
+	static constexpr uint32_t COMPACT_POSITIONS = 1U << 3;
+
+	struct Header {
+		uint32_t magic;
+		uint32_t version;
+		uint32_t particlesPerStrand;
+		uint32_t strandCount;
+		uint32_t velocityBytesPerParticle;	// Three floats, or three halves packed in two words
+		uint32_t flags;						// Options the buffer layouts depend on
+		float lastDeltaTime;				// The Verlet velocities are displacements over this step
+		uint32_t padding;
+		HairParameters parameters;
+		glm::vec3 translation;
+		glm::quat rotation;
+		glm::vec3 scale;
+	};
+
+	static Header makeHeader(const Hair& hair) {
+        const HairOptions& options = hair.getOptions();
+        Header result{};
+        result.magic = MAGIC;
+        result.version = VERSION;
+        result.particlesPerStrand = hair.getParticlesPerStrand();
+        result.strandCount = hair.getStrandCount();
+        result.velocityBytesPerParticle = options.halfPrecisionVelocities ? 2 * sizeof(uint32_t) : sizeof(glm::vec3);
+        result.flags = (options.halfPrecisionVelocities ? HALF_VELOCITIES : 0) | (options.verletIntegration ? VERLET_INTEGRATION : 0) |
+            (hair.getSegmentLengthBuffer() != GL_NONE ? SEGMENT_LENGTHS : 0) | (options.compactPositions ? COMPACT_POSITIONS : 0);
+        result.lastDeltaTime = hair.getLastDeltaTime();
+        result.parameters = hair.getParameters();
+        result.translation = hair.getTranslation();
+        result.rotation = hair.getRotation();
+        result.scale = hair.getScale();
+        return result;
+    }
+	// Compact positions store one packed direction per particle, and their roots after the rest of the payload
+	static size_t getPositionBytesPerParticle(const Header& fileHeader) {
+        return (fileHeader.flags & COMPACT_POSITIONS) ? sizeof(uint32_t) : sizeof(glm::vec3);
+    }
+	static size_t getPayloadSize(const Header& fileHeader) {
+        const size_t particleCount = static_cast<size_t>(fileHeader.strandCount) * fileHeader.particlesPerStrand;
+        return particleCount * (getPositionBytesPerParticle(fileHeader) + fileHeader.velocityBytesPerParticle) +
+            ((fileHeader.flags & SEGMENT_LENGTHS) ? fileHeader.strandCount * sizeof(float) : 0) +
+            ((fileHeader.flags & COMPACT_POSITIONS) ? fileHeader.strandCount * sizeof(glm::vec3) : 0);
+    }
+	static GLsizeiptr getMaximumPayloadSize(const Hair& hair) {
+        Header maximumHeader = makeHeader(hair);
+        maximumHeader.strandCount = MAX_HAIR_COUNT;
+        return static_cast<GLsizeiptr>(getPayloadSize(maximumHeader));
+    }
+
+	void startWriting() {
+        writer = std::thread([this]() {
+            std::ofstream stream(path, std::ios::binary | std::ios::trunc);
+            stream.write(reinterpret_cast<const char*>(&header), sizeof(Header));
+            stream.write(reinterpret_cast<const char*>(readback.getData()), readback.getSize());
+            if (stream)
+                std::cout << "Saved checkpoint " << path << std::endl;
+            else
+                std::cout << "Failed to write checkpoint " << path << std::endl;
+        });
+    }
+
+	BufferReadback readback;
+	Header header{};
+	std::string path;
+	std::thread writer;
+};
+
+inline bool HairCheckpoint::restore(Hair& hair, const std::string& path)
+{
+    const auto start = std::chrono::steady_clock::now();
+    const MappedFile file(path);
+    if (!file.isValid() || file.getSize() < sizeof(Header))
+        return false;
+
+    Header fileHeader;
+    std::memcpy(&fileHeader, file.getData(), sizeof(Header));
+    const Header expected = makeHeader(hair);
+    if (fileHeader.magic != MAGIC || fileHeader.version != VERSION || fileHeader.strandCount > MAX_HAIR_COUNT ||
+        fileHeader.particlesPerStrand != expected.particlesPerStrand || fileHeader.flags != expected.flags ||
+        file.getSize() != sizeof(Header) + getPayloadSize(fileHeader))
+    {
+        std::cout << "Checkpoint " << path << " doesn't match the hair's particles or options" << std::endl;
+        return false;
+    }
+
+    // One upload of the whole payload, then copies on the GPU into the hair's buffers
+    const GLsizeiptr payloadSize = static_cast<GLsizeiptr>(getPayloadSize(fileHeader));
+    GLuint uploadBuffer;
+    glCreateBuffers(1, &uploadBuffer);
+    glNamedBufferStorage(uploadBuffer, payloadSize, file.getData() + sizeof(Header), 0);
+    const GLsizeiptr particleCount = static_cast<GLsizeiptr>(fileHeader.strandCount) * fileHeader.particlesPerStrand;
+    const GLsizeiptr positionSize = particleCount * static_cast<GLsizeiptr>(getPositionBytesPerParticle(fileHeader));
+    const GLsizeiptr velocitySize = particleCount * fileHeader.velocityBytesPerParticle;
+    glCopyNamedBufferSubData(uploadBuffer, hair.getPositionBuffer(), 0, 0, positionSize);
+    glCopyNamedBufferSubData(uploadBuffer, hair.getVelocityBuffer(), positionSize, 0, velocitySize);
+    const GLsizeiptr segmentLengthSize = (fileHeader.flags & SEGMENT_LENGTHS) ?
+        static_cast<GLsizeiptr>(fileHeader.strandCount) * static_cast<GLsizeiptr>(sizeof(float)) : 0;
+    if (fileHeader.flags & SEGMENT_LENGTHS)
+        glCopyNamedBufferSubData(uploadBuffer, hair.getSegmentLengthBuffer(), positionSize + velocitySize, 0, segmentLengthSize);
+    if (fileHeader.flags & COMPACT_POSITIONS)
+        glCopyNamedBufferSubData(uploadBuffer, hair.getRootBuffer(), positionSize + velocitySize + segmentLengthSize, 0,
+            static_cast<GLsizeiptr>(fileHeader.strandCount) * static_cast<GLsizeiptr>(sizeof(glm::vec3)));
+    glDeleteBuffers(1, &uploadBuffer);
+
+    hair.setStrandCount(fileHeader.strandCount);
+    hair.setParameters(fileHeader.parameters);
+    hair.setLastDeltaTime(fileHeader.lastDeltaTime);
+    hair.translate(fileHeader.translation);
+    hair.setRotation(fileHeader.rotation);
+    hair.scale(fileHeader.scale);
+
+    std::cout << "Restored " << fileHeader.strandCount << " strands from " << path << " in " <<
+        std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count() << " ms" << std::endl;
+    return true;
+}
@@ -0,0 +1,123 @@
+#pragma once
+#include "ComputeShader.h"
+#include <algorithm>
+
+const uint32_t HASH_TABLE_SIZE = 1U << 18;			// Has to be a multiple of the scan block size (1024)
+const uint32_t SCAN_BLOCK_SIZE = 1024U;
+const float HAIR_COLLISION_RADIUS = 0.05f;
+const float HAIR_REPULSION_STIFFNESS = 0.2f;
+
+// Hair-hair repulsion built on a uniform spatial hash. Particles are counted into hashed cells,
+// the counts are prefix summed into cell offsets, particles are scattered into cell-sorted order and
+// every particle then searches the 27 neighbouring cells for particles of other strands.
+// Expects positions and velocities to be bound to storage binding points 0 and 1. With the BATCHED define
+// roots are transformed by the model matrix of their instance, read from binding points 9 and 10. With
+// COMPACT_POSITIONS the strands have to be decoded into a buffer of world space positions first, since the neighbour
+// search reads particles of arbitrary strands. The buffer stays bound to binding point 21, the hair shaders read it
+// too instead of walking the strands again.
+class HairCollision {
+public:
+	explicit HairCollision(uint32_t maxParticleCount, const std::vector<std::string>& defines = {}) : computeShader("HairCollisionShader.glsl", defines) {
+        computeShader.use();
+        computeShader.setUint("hashTableSize", HASH_TABLE_SIZE);
+        computeShader.setFloat("cellSize", HAIR_COLLISION_RADIUS);
+        computeShader.setFloat("collisionRadius", HAIR_COLLISION_RADIUS);
+        computeShader.setFloat("repulsionStiffness", HAIR_REPULSION_STIFFNESS);
+
+        cellCounts = createBuffer(HASH_TABLE_SIZE * sizeof(GLuint));
+        cellStarts = createBuffer(HASH_TABLE_SIZE * sizeof(GLuint));
+        particleCells = createBuffer(maxParticleCount * 2 * sizeof(GLuint));
+        sortedParticles = createBuffer(maxParticleCount * sizeof(GLuint));
+        blockSums = createBuffer(HASH_TABLE_SIZE / SCAN_BLOCK_SIZE * sizeof(GLuint));
+        if (std::find(defines.begin(), defines.end(), "COMPACT_POSITIONS") != defines.end())
+            decodedPositions = createBuffer(maxParticleCount * 3 * sizeof(GLfloat));
+    }
+	~HairCollision() {
+        glDeleteBuffers(1, &cellCounts);
+        glDeleteBuffers(1, &cellStarts);
+        glDeleteBuffers(1, &particleCells);
+        glDeleteBuffers(1, &sortedParticles);
+        glDeleteBuffers(1, &blockSums);
+        glDeleteBuffers(1, &decodedPositions);
+    }
+
+	// Decodes every strand once into the decoded positions, only with COMPACT_POSITIONS
+	void decode(const glm::mat4& model, uint32_t particleCount, uint32_t particlesPerStrand);
+	// Expects the positions to be decoded since the last step with COMPACT_POSITIONS
+	void resolve(const glm::mat4& model, uint32_t particleCount, uint32_t particlesPerStrand, float deltaTime);
+
+	GLuint getDecodedPositions() const { return decodedPositions; }
+
+private:
+	static GLuint createBuffer(GLsizeiptr size) {
+        GLuint buffer;
+        glGenBuffers(1, &buffer);
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, buffer);
+        glBufferData(GL_SHADER_STORAGE_BUFFER, size, nullptr, GL_DYNAMIC_DRAW);
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, GL_NONE);
+        return buffer;
+    }
+
+	void dispatch(uint32_t state, GLuint workGroupCount) {
+        computeShader.setUint("state", state);
+        computeShader.setGlobalWorkGroupCount(workGroupCount);
+        computeShader.dispatch();
+        glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+    }
+
+	ComputeShader computeShader;
+	GLuint cellCounts = GL_NONE;
+	GLuint cellStarts = GL_NONE;
+	GLuint particleCells = GL_NONE;
+	GLuint sortedParticles = GL_NONE;
+	GLuint blockSums = GL_NONE;
+	GLuint decodedPositions = GL_NONE;			// Only allocated for compact positions
+};
+
+inline void HairCollision::decode(const glm::mat4& model, uint32_t particleCount, uint32_t particlesPerStrand)
+{
+    if (decodedPositions == GL_NONE)
+        return;
+
+    computeShader.use();
+    computeShader.setMat4("model", model);
+    computeShader.setUint("particleCount", particleCount);
+    computeShader.setUint("particlesPerStrand", particlesPerStrand);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 21, decodedPositions);
+    const GLuint localWorkGroupCountX = computeShader.getLocalWorkGroupsCount().x;
+    const uint32_t strandCount = particleCount / particlesPerStrand;
+    dispatch(6, (strandCount + localWorkGroupCountX - 1) / localWorkGroupCountX);
+}
+
+inline void HairCollision::resolve(const glm::mat4& model, uint32_t particleCount, uint32_t particlesPerStrand, float deltaTime)
+{
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 4, cellCounts);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 5, cellStarts);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 6, particleCells);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 7, sortedParticles);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 8, blockSums);
+
+    const GLuint zero = 0;
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, cellCounts);
+    glClearBufferData(GL_SHADER_STORAGE_BUFFER, GL_R32UI, GL_RED_INTEGER, GL_UNSIGNED_INT, &zero);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, GL_NONE);
+    glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+
+    computeShader.use();
+    computeShader.setMat4("model", model);
+    computeShader.setUint("particleCount", particleCount);
+    computeShader.setUint("particlesPerStrand", particlesPerStrand);
+    computeShader.setFloat("deltaTime", deltaTime);
+
+    const GLuint localWorkGroupCountX = computeShader.getLocalWorkGroupsCount().x;
+    const GLuint particleWorkGroupCount = (particleCount + localWorkGroupCountX - 1) / localWorkGroupCountX;
+
+    if (decodedPositions != GL_NONE)
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 21, decodedPositions);
+    dispatch(0, particleWorkGroupCount);						// Count particles per cell
+    dispatch(1, HASH_TABLE_SIZE / SCAN_BLOCK_SIZE);				// Scan every block of cell counts
+    dispatch(2, 1);												// Scan the block sums
+    dispatch(3, HASH_TABLE_SIZE / localWorkGroupCountX);		// Add scanned block sums to the cell offsets
+    dispatch(4, particleWorkGroupCount);						// Scatter particles into sorted cell lists
+    dispatch(5, particleWorkGroupCount);						// Repulse particles closer than the collision radius
+}
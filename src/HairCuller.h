@@ -0,0 +1,145 @@
+#pragma once
+#include "Camera.h"
+#include "ComputeShader.h"
+#include <algorithm>
+#include <array>
+#include <vector>
+
+const float LOD_BOUNDS_RADIUS = 5.f;				// Sphere enclosing the head and the hanging strands
+const float LOD_FULL_DETAIL_SIZE = 0.6f;			// Projected bounds, as a fraction of half the screen height, drawn with every strand
+const float LOD_MINIMUM_STRAND_FRACTION = 0.1f;
+const float LOD_FADE_BAND = 0.15f;
+const std::array<float, 2> LOD_LEVEL_SIZES = { 0.3f, 0.12f };	// Below these sizes strands use every 2nd and every 4th particle
+const float LOD_LEVEL_BAND = 0.2f;					// Relative size range around a level size over which strands switch one by one
+
+// Tests the bounding sphere of every strand against the camera frustum on the GPU and appends the visible
+// strands to an indirect draw buffer. The number of visible strands never comes back to the CPU, the draw
+// reads it from the parameter buffer. Expects positions to be bound to storage binding point 0.
+//
+// With level of detail enabled the pass also keeps a deterministic, hash selected subset of the strands when the
+// hair is small on screen. Strands near the selection threshold fade out instead of popping, and the survivors
+// get a compensating opacity, written per strand to storage binding point 18 for shaders compiled with STRAND_LOD.
+// Opaque hair can't be drawn more than fully opaque, so with width compensation the survivors are drawn with wider
+// lines instead and the opacity only carries the fade. Small hair is also drawn through decimated index patterns
+// that skip particles along the strand, switching strand by strand around the level sizes.
+class HairCuller {
+public:
+	HairCuller(uint32_t maxStrandCount, uint32_t particlesPerStrand, const std::vector<std::string>& defines = {})
+    : computeShader("HairCullShader.glsl", defines) {
+        glGenBuffers(1, &commandBuffer);
+        glBindBuffer(GL_DRAW_INDIRECT_BUFFER, commandBuffer);
+        glBufferData(GL_DRAW_INDIRECT_BUFFER, maxStrandCount * 5 * sizeof(GLuint), nullptr, GL_DYNAMIC_DRAW);
+        glBindBuffer(GL_DRAW_INDIRECT_BUFFER, GL_NONE);
+
+        glGenBuffers(1, &drawCountBuffer);
+        glBindBuffer(GL_PARAMETER_BUFFER, drawCountBuffer);
+        glBufferData(GL_PARAMETER_BUFFER, sizeof(GLuint), nullptr, GL_DYNAMIC_DRAW);
+        glBindBuffer(GL_PARAMETER_BUFFER, GL_NONE);
+
+        glGenBuffers(1, &opacityBuffer);
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, opacityBuffer);
+        glBufferData(GL_SHADER_STORAGE_BUFFER, maxStrandCount * sizeof(float), nullptr, GL_DYNAMIC_DRAW);
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, GL_NONE);
+
+        // Index patterns of one strand, relative to its first particle. Every level keeps the root and the tip.
+        std::vector<GLuint> indices;
+        std::array<GLuint, 3> levelFirstIndices{};
+        std::array<GLuint, 3> levelCounts{};
+        for (uint32_t level = 0; level < 3; ++level)
+        {
+            levelFirstIndices[level] = static_cast<GLuint>(indices.size());
+            for (uint32_t i = 0; i < particlesPerStrand - 1; i += 1U << level)
+            {
+                indices.push_back(i);
+            }
+            indices.push_back(particlesPerStrand - 1);
+            levelCounts[level] = static_cast<GLuint>(indices.size()) - levelFirstIndices[level];
+        }
+
+        glGenBuffers(1, &indexBuffer);
+        glBindBuffer(GL_COPY_WRITE_BUFFER, indexBuffer);
+        glBufferData(GL_COPY_WRITE_BUFFER, indices.size() * sizeof(GLuint), indices.data(), GL_STATIC_DRAW);
+        glBindBuffer(GL_COPY_WRITE_BUFFER, GL_NONE);
+
+        computeShader.use();
+        computeShader.setUint("particlesPerStrand", particlesPerStrand);
+        computeShader.setFloat("boundsRadius", LOD_BOUNDS_RADIUS);
+        computeShader.setFloat("fullDetailSize", LOD_FULL_DETAIL_SIZE);
+        computeShader.setFloat("minimumStrandFraction", LOD_MINIMUM_STRAND_FRACTION);
+        computeShader.setFloat("fadeBand", LOD_FADE_BAND);
+        computeShader.setFloatArray("levelSizes", static_cast<GLsizei>(LOD_LEVEL_SIZES.size()), LOD_LEVEL_SIZES.data());
+        computeShader.setFloat("levelBand", LOD_LEVEL_BAND);
+        computeShader.setUintArray("levelFirstIndices", 3, levelFirstIndices.data());
+        computeShader.setUintArray("levelCounts", 3, levelCounts.data());
+    }
+	~HairCuller() {
+        glDeleteBuffers(1, &commandBuffer);
+        glDeleteBuffers(1, &drawCountBuffer);
+        glDeleteBuffers(1, &opacityBuffer);
+        glDeleteBuffers(1, &indexBuffer);
+    }
+	HairCuller(const HairCuller&) = delete;
+	HairCuller& operator=(const HairCuller&) = delete;
+
+	void cull(const PerspectiveCamera& camera, const glm::mat4& model, uint32_t strandCount) {
+        const GLuint zero = 0;
+        glBindBuffer(GL_PARAMETER_BUFFER, drawCountBuffer);
+        glClearBufferData(GL_PARAMETER_BUFFER, GL_R32UI, GL_RED_INTEGER, GL_UNSIGNED_INT, &zero);
+        glBindBuffer(GL_PARAMETER_BUFFER, GL_NONE);
+        glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 13, commandBuffer);
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 14, drawCountBuffer);
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 18, opacityBuffer);
+
+        const auto frustumPlanes = camera.getFrustumPlanes();
+        computeShader.use();
+        computeShader.setVec4Array("frustumPlanes", static_cast<GLsizei>(frustumPlanes.size()), frustumPlanes.data());
+        computeShader.setMat4("model", model);
+        computeShader.setUint("strandCount", strandCount);
+        computeShader.setBool("lodEnabled", lodEnabled);
+        computeShader.setBool("opacityCompensation", !widthCompensation);
+        computeShader.setVec3("cameraPosition", camera.getPosition());
+        computeShader.setFloat("projectionScale", camera.getProjection()[1][1]);
+
+        const GLuint localWorkGroupCountX = computeShader.getLocalWorkGroupsCount().x;
+        computeShader.setGlobalWorkGroupCount((strandCount + localWorkGroupCountX - 1) / localWorkGroupCountX);
+        computeShader.dispatch();
+        glMemoryBarrier(GL_COMMAND_BARRIER_BIT | GL_ELEMENT_ARRAY_BARRIER_BIT | GL_SHADER_STORAGE_BARRIER_BIT);
+
+        // Same fraction of surviving strands as the cull shader, it only depends on the hair's distance
+        const float projectedSize = LOD_BOUNDS_RADIUS * camera.getProjection()[1][1] /
+            std::max(glm::distance(camera.getPosition(), glm::vec3(model[3])), 1e-3f);
+        density = lodEnabled ? std::clamp(projectedSize / LOD_FULL_DETAIL_SIZE, LOD_MINIMUM_STRAND_FRACTION, 1.f) : 1.f;
+    }
+
+	// Draws the strands that passed the last cull with the currently bound vertex array, whose element buffer is replaced
+	void draw(uint32_t maxStrandCount) const {
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 18, opacityBuffer);
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, indexBuffer);
+        glBindBuffer(GL_DRAW_INDIRECT_BUFFER, commandBuffer);
+        glBindBuffer(GL_PARAMETER_BUFFER, drawCountBuffer);
+        if (widthCompensation)
+            glLineWidth(1.f / density);
+        glMultiDrawElementsIndirectCount(GL_LINE_STRIP, GL_UNSIGNED_INT, nullptr, 0, maxStrandCount, 0);
+        if (widthCompensation)
+            glLineWidth(1.f);
+        glBindBuffer(GL_PARAMETER_BUFFER, GL_NONE);
+        glBindBuffer(GL_DRAW_INDIRECT_BUFFER, GL_NONE);
+    }
+
+	void setLodEnabled(bool enabled) { lodEnabled = enabled; }
+	bool isLodEnabled() const { return lodEnabled; }
+	// Compensates the missing strands with wider lines instead of a higher opacity, for hair drawn opaque
+	void setWidthCompensation(bool enabled) { widthCompensation = enabled; }
+
+private:
+	ComputeShader computeShader;
+	GLuint commandBuffer = GL_NONE;
+	GLuint drawCountBuffer = GL_NONE;
+	GLuint opacityBuffer = GL_NONE;
+	GLuint indexBuffer = GL_NONE;
+	bool lodEnabled = false;
+	bool widthCompensation = false;
+	float density = 1.f;			// Fraction of the strands kept by the last cull
+};
@@ -0,0 +1,47 @@
+#pragma once
+#include <glad/glad.h>
+#include <algorithm>
+#include <vector>
+
+// Patches of four particles per strand segment, the segment and its neighbours, clamped at the root and the tip.
+// Drawn with a TessellationShader that evaluates a Catmull-Rom spline, so strands stay smooth with few particles.
+// Positions are pulled from storage binding point 0 by the vertex shader, the vertex array has no attributes.
+class HairCurves {
+public:
+	HairCurves(uint32_t maxStrandCount, uint32_t _particlesPerStrand) : particlesPerStrand(_particlesPerStrand) {
+        std::vector<GLuint> indices;
+        indices.reserve(maxStrandCount * (particlesPerStrand - 1) * 4);
+        for (uint32_t strand = 0; strand < maxStrandCount; ++strand)
+        {
+            const GLuint first = strand * particlesPerStrand;
+            const GLuint last = first + particlesPerStrand - 1;
+            for (GLuint i = first; i < last; ++i)
+            {
+                indices.insert(indices.end(), { std::max(i, first + 1) - 1, i, i + 1, std::min(i + 2, last) });
+            }
+        }
+
+        glCreateVertexArrays(1, &vao);
+        glCreateBuffers(1, &indexBuffer);
+        glNamedBufferStorage(indexBuffer, indices.size() * sizeof(GLuint), indices.data(), 0);
+        glVertexArrayElementBuffer(vao, indexBuffer);
+    }
+	~HairCurves() {
+        glDeleteVertexArrays(1, &vao);
+        glDeleteBuffers(1, &indexBuffer);
+    }
+	HairCurves(const HairCurves&) = delete;
+	HairCurves& operator=(const HairCurves&) = delete;
+
+	void draw(uint32_t strandCount) const {
+        glPatchParameteri(GL_PATCH_VERTICES, 4);
+        glBindVertexArray(vao);
+        glDrawElements(GL_PATCHES, strandCount * (particlesPerStrand - 1) * 4, GL_UNSIGNED_INT, nullptr);
+        glBindVertexArray(GL_NONE);
+    }
+
+private:
+	uint32_t particlesPerStrand;
+	GLuint vao = GL_NONE;
+	GLuint indexBuffer = GL_NONE;
+};
@@ -0,0 +1,168 @@
+#pragma once
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+#include "CompactPositions.h"
+#include "MappedFile.h"
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <vector>
+
+const uint32_t HAIR_IMPORT_CHUNK_STRANDS = 1024U;		// Strands resampled between two uploads
+const float HAIR_IMPORT_MINIMUM_LENGTH = 1e-5f;			// Shorter strands can't give the solver a direction and are skipped
+
+// Streaming reader of the binary hair format of Cem Yuksel (www.cemyuksel.com/research/hairmodels). The file is
+// memory mapped and every strand is resampled by arc length to the solver's particles per strand, a chunk of strands
+// at a time, and uploaded to the position buffer, so the whole groom never exists as a second copy in memory.
+class HairFileImporter {
+public:
+	explicit HairFileImporter(const std::string& path) : file(path) {
+        if (!file.isValid() || file.getSize() < sizeof(Header))
+            return;
+
+        std::memcpy(&header, file.getData(), sizeof(Header));
+        if (std::memcmp(header.signature, "HAIR", 4) != 0 || !(header.arrays & POINTS_ARRAY))
+            return;
+
+        segmentsOffset = sizeof(Header);
+        pointsOffset = segmentsOffset + ((header.arrays & SEGMENTS_ARRAY) ? header.strandCount * sizeof(uint16_t) : 0);
+        valid = file.getSize() >= pointsOffset + static_cast<size_t>(header.pointCount) * 3 * sizeof(float);
+    }
+	HairFileImporter(const HairFileImporter&) = delete;
+	HairFileImporter& operator=(const HairFileImporter&) = delete;
+
+	// Writes up to maxStrandCount strands, evenly thinned when the file has more, with their segment lengths. With a
+	// root buffer the strands are stored as compact positions, the position buffer receives the segment directions.
+	// Returns the number of strands written.
+	uint32_t import(GLuint positionBuffer, GLuint segmentLengthBuffer, uint32_t maxStrandCount, uint32_t particlesPerStrand,
+		const glm::mat4& transform, GLuint rootBuffer = GL_NONE) const;
+
+	bool isValid() const { return valid; }
+	uint32_t getStrandCount() const { return header.strandCount; }
+
+private:
+	static constexpr uint32_t SEGMENTS_ARRAY = 1U << 0;
+	static constexpr uint32_t POINTS_ARRAY = 1U << 1;
+
+	struct Header {
+		char signature[4];
+		uint32_t strandCount;
+		uint32_t pointCount;
+		uint32_t arrays;			// Bit field of the arrays that follow the header
+		uint32_t defaultSegmentCount;
+		float defaultThickness;
+		float defaultTransparency;
+		float defaultColor[3];
+		char info[88];
+	};
+	static_assert(sizeof(Header) == 128, "The hair file header is 128 bytes");
+
+	// The points array follows 16-bit segment counts and isn't necessarily aligned for floats
+	glm::vec3 readPoint(uint32_t point, const glm::mat4& transform) const {
+        float coordinates[3];
+        std::memcpy(coordinates, file.getData() + pointsOffset + static_cast<size_t>(point) * sizeof(coordinates), sizeof(coordinates));
+        return glm::vec3(transform * glm::vec4(coordinates[0], coordinates[1], coordinates[2], 1.f));
+    }
+
+	MappedFile file;
+	Header header{};
+	size_t segmentsOffset = 0;
+	size_t pointsOffset = 0;
+	bool valid = false;
+};
+
+inline uint32_t HairFileImporter::import(GLuint positionBuffer, GLuint segmentLengthBuffer, uint32_t maxStrandCount,
+	uint32_t particlesPerStrand, const glm::mat4& transform, GLuint rootBuffer) const
+{
+    if (!valid)
+        return 0;
+
+    std::vector<glm::vec3> positions(static_cast<size_t>(HAIR_IMPORT_CHUNK_STRANDS) * particlesPerStrand);
+    std::vector<float> segmentLengths(HAIR_IMPORT_CHUNK_STRANDS);
+    std::vector<glm::vec3> roots(rootBuffer ? HAIR_IMPORT_CHUNK_STRANDS : 0);
+    std::vector<uint32_t> directions(rootBuffer ? positions.size() : 0);
+    uint32_t importedCount = 0;
+    uint32_t chunkCount = 0;
+    const auto uploadChunk = [&]() {
+        const GLintptr firstStrand = importedCount - chunkCount;
+        if (rootBuffer)
+        {
+            CompactPositions::encodeStrands(positions.data(), chunkCount, particlesPerStrand, roots.data(), directions.data());
+            glNamedBufferSubData(rootBuffer, firstStrand * sizeof(glm::vec3), chunkCount * sizeof(glm::vec3), roots.data());
+            glNamedBufferSubData(positionBuffer, firstStrand * particlesPerStrand * sizeof(uint32_t),
+                static_cast<GLsizeiptr>(chunkCount) * particlesPerStrand * sizeof(uint32_t), directions.data());
+        }
+        else
+        {
+            glNamedBufferSubData(positionBuffer, firstStrand * particlesPerStrand * sizeof(glm::vec3),
+                static_cast<GLsizeiptr>(chunkCount) * particlesPerStrand * sizeof(glm::vec3), positions.data());
+        }
+        glNamedBufferSubData(segmentLengthBuffer, firstStrand * sizeof(float), chunkCount * sizeof(float), segmentLengths.data());
+        chunkCount = 0;
+    };
+
+    uint32_t firstPoint = 0;
+    for (uint32_t strand = 0; strand < header.strandCount && importedCount < maxStrandCount; ++strand)
+    {
+        uint32_t segmentCount = header.defaultSegmentCount;
+        if (header.arrays & SEGMENTS_ARRAY)
+        {
+            uint16_t count;
+            std::memcpy(&count, file.getData() + segmentsOffset + strand * sizeof(uint16_t), sizeof(count));
+            segmentCount = count;
+        }
+        const uint32_t pointCount = segmentCount + 1;
+        if (firstPoint + pointCount > header.pointCount)
+            break;
+
+        // Strand i is kept when it crosses a multiple of the thinning ratio, which spreads the kept strands evenly
+        const bool selected = static_cast<uint64_t>(strand + 1) * maxStrandCount / header.strandCount >
+            static_cast<uint64_t>(strand) * maxStrandCount / header.strandCount || header.strandCount <= maxStrandCount;
+        float length = 0.f;
+        if (selected)
+        {
+            for (uint32_t point = 1; point < pointCount; ++point)
+            {
+                length += glm::distance(readPoint(firstPoint + point - 1, transform), readPoint(firstPoint + point, transform));
+            }
+        }
+        if (!selected || length < HAIR_IMPORT_MINIMUM_LENGTH)
+        {
+            firstPoint += pointCount;
+            continue;
+        }
+
+        // Particles at equal arc length steps along the polyline
+        const float segmentLength = length / (particlesPerStrand - 1);
+        glm::vec3* particles = &positions[static_cast<size_t>(chunkCount) * particlesPerStrand];
+        uint32_t point = 0;
+        glm::vec3 segmentStart = readPoint(firstPoint, transform);
+        glm::vec3 segmentEnd = readPoint(firstPoint + 1, transform);
+        float segmentStartDistance = 0.f;
+        for (uint32_t particle = 0; particle < particlesPerStrand; ++particle)
+        {
+            const float distance = particle * segmentLength;
+            float currentLength = glm::distance(segmentStart, segmentEnd);
+            while (segmentStartDistance + currentLength < distance && point + 2 < pointCount)
+            {
+                segmentStartDistance += currentLength;
+                ++point;
+                segmentStart = segmentEnd;
+                segmentEnd = readPoint(firstPoint + point + 1, transform);
+                currentLength = glm::distance(segmentStart, segmentEnd);
+            }
+            const float t = currentLength > 0.f ? glm::clamp((distance - segmentStartDistance) / currentLength, 0.f, 1.f) : 0.f;
+            particles[particle] = glm::mix(segmentStart, segmentEnd, t);
+        }
+        segmentLengths[chunkCount] = segmentLength;
+
+        firstPoint += pointCount;
+        ++importedCount;
+        if (++chunkCount == HAIR_IMPORT_CHUNK_STRANDS)
+            uploadChunk();
+    }
+    if (chunkCount > 0)
+        uploadChunk();
+
+    return importedCount;
+}
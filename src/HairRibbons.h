@@ -0,0 +1,99 @@
+#pragma once
+#include "Camera.h"
+#include "ComputeShader.h"
+#include <algorithm>
+#include <vector>
+
+const float HAIR_RIBBON_TIP_WIDTH_SCALE = 0.25f;		// Tip width relative to the root width
+
+// Expands every simulated particle into the two edge vertices of a camera facing ribbon, tapered from the root
+// to the tip, so the strands are drawn as triangles of a controllable width with a single indexed call.
+// Expects positions to be bound to storage binding point 0 when generating. With COMPACT_POSITIONS one invocation
+// expands a whole strand, so it is decoded once.
+class HairRibbons {
+public:
+	HairRibbons(uint32_t maxStrandCount, uint32_t _particlesPerStrand, const std::vector<std::string>& defines = {})
+    : particlesPerStrand(_particlesPerStrand),
+    compactPositions(std::find(defines.begin(), defines.end(), "COMPACT_POSITIONS") != defines.end()),
+    computeShader("HairRibbonShader.glsl", defines) {
+        const uint32_t vertexCount = maxStrandCount * particlesPerStrand * 2;
+        glGenBuffers(1, &vertexBuffer);
+        glBindBuffer(GL_ARRAY_BUFFER, vertexBuffer);
+        glBufferData(GL_ARRAY_BUFFER, vertexCount * 2 * sizeof(glm::vec4), nullptr, GL_DYNAMIC_DRAW);
+
+        // Two triangles per segment, the topology never changes so the indices are built once
+        std::vector<GLuint> indices;
+        indices.reserve(maxStrandCount * (particlesPerStrand - 1) * 6);
+        for (uint32_t strand = 0; strand < maxStrandCount; ++strand)
+        {
+            for (uint32_t i = 0; i < particlesPerStrand - 1; ++i)
+            {
+                const GLuint left = (strand * particlesPerStrand + i) * 2;
+                indices.insert(indices.end(), { left, left + 1, left + 2, left + 1, left + 3, left + 2 });
+            }
+        }
+
+        glGenVertexArrays(1, &vao);
+        glBindVertexArray(vao);
+        glGenBuffers(1, &indexBuffer);
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, indexBuffer);
+        glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(GLuint), indices.data(), GL_STATIC_DRAW);
+        glVertexAttribPointer(0, 4, GL_FLOAT, GL_FALSE, 2 * sizeof(glm::vec4), (void*)0);
+        glEnableVertexAttribArray(0);
+        glVertexAttribPointer(1, 4, GL_FLOAT, GL_FALSE, 2 * sizeof(glm::vec4), (void*)sizeof(glm::vec4));
+        glEnableVertexAttribArray(1);
+        glBindVertexArray(GL_NONE);
+        glBindBuffer(GL_ARRAY_BUFFER, GL_NONE);
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, GL_NONE);
+    }
+	~HairRibbons() {
+        glDeleteVertexArrays(1, &vao);
+        glDeleteBuffers(1, &vertexBuffer);
+        glDeleteBuffers(1, &indexBuffer);
+    }
+	HairRibbons(const HairRibbons&) = delete;
+	HairRibbons& operator=(const HairRibbons&) = delete;
+
+	void generate(const PerspectiveCamera& camera, const glm::mat4& model, uint32_t strandCount, float viewportHeight) {
+        const uint32_t particleCount = strandCount * particlesPerStrand;
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 15, vertexBuffer);
+        computeShader.use();
+        computeShader.setMat4("model", model);
+        computeShader.setVec3("cameraPosition", camera.getPosition());
+        computeShader.setUint("particleCount", particleCount);
+        computeShader.setUint("particlesPerStrand", particlesPerStrand);
+        computeShader.setFloat("rootWidth", rootWidth);
+        computeShader.setFloat("tipWidthScale", HAIR_RIBBON_TIP_WIDTH_SCALE);
+        computeShader.setFloat("pixelSize", 2.f / (camera.getProjection()[1][1] * viewportHeight));
+
+        const GLuint localWorkGroupCountX = computeShader.getLocalWorkGroupsCount().x;
+        const uint32_t invocationCount = compactPositions ? strandCount : particleCount;
+        computeShader.setGlobalWorkGroupCount((invocationCount + localWorkGroupCountX - 1) / localWorkGroupCountX);
+        computeShader.dispatch();
+        glMemoryBarrier(GL_VERTEX_ATTRIB_ARRAY_BARRIER_BIT);
+    }
+
+	// The ribbons are alpha blended in draw order, so they are tested against the depth buffer without writing it.
+	// Otherwise the faded edges of a ribbon would hide the ribbons drawn behind it afterwards.
+	void draw(uint32_t strandCount) const {
+        GLboolean depthWriteEnabled = GL_TRUE;
+        glGetBooleanv(GL_DEPTH_WRITEMASK, &depthWriteEnabled);
+        glDepthMask(GL_FALSE);
+        glBindVertexArray(vao);
+        glDrawElements(GL_TRIANGLES, strandCount * (particlesPerStrand - 1) * 6, GL_UNSIGNED_INT, nullptr);
+        glBindVertexArray(GL_NONE);
+        glDepthMask(depthWriteEnabled);
+    }
+
+	void setRootWidth(float width) { rootWidth = width; }
+	float getRootWidth() const { return rootWidth; }
+
+private:
+	uint32_t particlesPerStrand;
+	bool compactPositions;
+	float rootWidth = 0.01f;
+	ComputeShader computeShader;
+	GLuint vertexBuffer = GL_NONE;
+	GLuint indexBuffer = GL_NONE;
+	GLuint vao = GL_NONE;
+};
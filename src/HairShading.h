@@ -0,0 +1,69 @@
+#pragma once
+#include "Shader.h"
+#include <cmath>
+#include <vector>
+
+const uint32_t KAJIYA_KAY_LUT_RESOLUTION = 128U;
+const float HAIR_SPECULAR_EXPONENT = 80.f;
+const glm::vec3 HAIR_COLOR{ 0.3f, 0.18f, 0.09f };
+const glm::vec3 LIGHT_POSITION{ 5.f, 6.f, 5.f };
+const GLuint SHADING_LUT_TEXTURE_UNIT = 1;		// Unit 0 holds the wind field during the simulation
+
+// Kajiya-Kay illumination of the hair strands. Both anisotropic terms depend only on dot products with the
+// tangent, so they are tabulated in a 2D texture indexed by T.L and T.H: red is the diffuse term sin(T, L),
+// green the specular term sin(T, H)^exponent. Shading a fragment is then a single filtered fetch.
+class HairShading {
+public:
+	HairShading() {
+        std::vector<glm::vec2> lut(KAJIYA_KAY_LUT_RESOLUTION * KAJIYA_KAY_LUT_RESOLUTION);
+        for (uint32_t y = 0; y < KAJIYA_KAY_LUT_RESOLUTION; ++y)
+        {
+            const float tangentDotHalf = (y + 0.5f) / KAJIYA_KAY_LUT_RESOLUTION * 2.f - 1.f;
+            const float specular = std::pow(std::sqrt(std::max(0.f, 1.f - tangentDotHalf * tangentDotHalf)), HAIR_SPECULAR_EXPONENT);
+            for (uint32_t x = 0; x < KAJIYA_KAY_LUT_RESOLUTION; ++x)
+            {
+                const float tangentDotLight = (x + 0.5f) / KAJIYA_KAY_LUT_RESOLUTION * 2.f - 1.f;
+                lut[y * KAJIYA_KAY_LUT_RESOLUTION + x] = glm::vec2(std::sqrt(std::max(0.f, 1.f - tangentDotLight * tangentDotLight)), specular);
+            }
+        }
+
+        glCreateTextures(GL_TEXTURE_2D, 1, &lutTexture);
+        glTextureStorage2D(lutTexture, 1, GL_RG16F, KAJIYA_KAY_LUT_RESOLUTION, KAJIYA_KAY_LUT_RESOLUTION);
+        glTextureSubImage2D(lutTexture, 0, 0, 0, KAJIYA_KAY_LUT_RESOLUTION, KAJIYA_KAY_LUT_RESOLUTION, GL_RG, GL_FLOAT, lut.data());
+        glTextureParameteri(lutTexture, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+        glTextureParameteri(lutTexture, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        glTextureParameteri(lutTexture, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        glTextureParameteri(lutTexture, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    }
+	~HairShading() {
+        glDeleteTextures(1, &lutTexture);
+    }
+	HairShading(const HairShading&) = delete;
+	HairShading& operator=(const HairShading&) = delete;
+
+	// Sets the lighting uniforms of a hair drawing shader, which has to be in use
+	void apply(const Shader& shader, const glm::vec3& cameraPosition) const {
+        glBindTextureUnit(SHADING_LUT_TEXTURE_UNIT, lutTexture);
+        shader.setInt("shadingLut", SHADING_LUT_TEXTURE_UNIT);
+        applyLight(shader);
+        shader.setVec3("hairColor", hairColor);
+        shader.setVec3("cameraPosition", cameraPosition);
+    }
+
+	// Sets only the light uniforms, for shaders such as the head's that share the light but not the hair shading
+	void applyLight(const Shader& shader) const {
+        shader.setVec3("lightPosition", lightPosition);
+        shader.setVec3("lightColor", lightColor);
+    }
+
+	void setLightPosition(const glm::vec3& position) { lightPosition = position; }
+	const glm::vec3& getLightPosition() const { return lightPosition; }
+	void setLightColor(const glm::vec3& color) { lightColor = color; }
+	void setHairColor(const glm::vec3& color) { hairColor = color; }
+
+private:
+	GLuint lutTexture = GL_NONE;
+	glm::vec3 lightPosition = LIGHT_POSITION;
+	glm::vec3 lightColor{ 1.f };
+	glm::vec3 hairColor = HAIR_COLOR;
+};
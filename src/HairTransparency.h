@@ -0,0 +1,185 @@
+#pragma once
+#include "DrawingShader.h"
+#include "GpuProfiler.h"
+#include <string>
+#include <vector>
+
+const uint32_t LINKED_LIST_NODES_PER_PIXEL = 8U;		// Average list length the node pool is sized for
+const GLuint TRANSPARENCY_ACCUMULATION_TEXTURE_UNIT = 4;
+const GLuint TRANSPARENCY_REVEALAGE_TEXTURE_UNIT = 5;
+const GLuint TRANSPARENCY_HEAD_POINTER_IMAGE_UNIT = 1;	// Image unit 0 is written by the wind field
+
+enum class TransparencyMode {
+	Opaque,
+	WeightedBlended,	// Weighted blended order independent transparency, approximate
+	LinkedList			// Per pixel fragment lists sorted in the resolve, exact reference
+};
+
+// Order independent transparency for the hair strands, in a single geometry pass without sorting the strands.
+// Hair is drawn between begin and end with a hair shader compiled with getDefines, end composites the result
+// over the framebuffer bound at begin with a fullscreen triangle. Depth already in that framebuffer, the head,
+// occludes the strands in both modes.
+class HairTransparency {
+public:
+	HairTransparency(TransparencyMode _mode, const glm::ivec2& _size)
+    : mode(_mode), size(_size),
+    resolveShader("TransparencyResolveVertexShader.glsl", "TransparencyResolveFragmentShader.glsl", getDefines(_mode)) {
+        glCreateVertexArrays(1, &emptyVao);
+        if (mode == TransparencyMode::WeightedBlended)
+        {
+            glCreateTextures(GL_TEXTURE_2D, 1, &accumulationTexture);
+            glTextureStorage2D(accumulationTexture, 1, GL_RGBA16F, size.x, size.y);
+            glCreateTextures(GL_TEXTURE_2D, 1, &revealageTexture);
+            glTextureStorage2D(revealageTexture, 1, GL_R16F, size.x, size.y);
+            // Same format as the default depth buffer, which is copied in every frame for the head occlusion
+            glCreateTextures(GL_TEXTURE_2D, 1, &depthTexture);
+            glTextureStorage2D(depthTexture, 1, GL_DEPTH24_STENCIL8, size.x, size.y);
+            glCreateFramebuffers(1, &framebuffer);
+            glNamedFramebufferTexture(framebuffer, GL_COLOR_ATTACHMENT0, accumulationTexture, 0);
+            glNamedFramebufferTexture(framebuffer, GL_COLOR_ATTACHMENT1, revealageTexture, 0);
+            glNamedFramebufferTexture(framebuffer, GL_DEPTH_STENCIL_ATTACHMENT, depthTexture, 0);
+            const GLenum drawBuffers[] = { GL_COLOR_ATTACHMENT0, GL_COLOR_ATTACHMENT1 };
+            glNamedFramebufferDrawBuffers(framebuffer, 2, drawBuffers);
+            if (glCheckNamedFramebufferStatus(framebuffer, GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+                std::cout << "Transparency framebuffer is incomplete" << std::endl;
+
+            resolveShader.use();
+            resolveShader.setInt("accumulationTexture", TRANSPARENCY_ACCUMULATION_TEXTURE_UNIT);
+            resolveShader.setInt("revealageTexture", TRANSPARENCY_REVEALAGE_TEXTURE_UNIT);
+        }
+        else if (mode == TransparencyMode::LinkedList)
+        {
+            maxNodeCount = size.x * size.y * LINKED_LIST_NODES_PER_PIXEL;
+            glCreateTextures(GL_TEXTURE_2D, 1, &headPointerTexture);
+            glTextureStorage2D(headPointerTexture, 1, GL_R32UI, size.x, size.y);
+            glCreateBuffers(1, &nodeBuffer);
+            glNamedBufferStorage(nodeBuffer, static_cast<GLsizeiptr>(maxNodeCount) * 3 * sizeof(GLuint), nullptr, 0);
+            glCreateBuffers(1, &nodeCountBuffer);
+            glNamedBufferStorage(nodeCountBuffer, sizeof(GLuint), nullptr, GL_DYNAMIC_STORAGE_BIT);
+        }
+    }
+	~HairTransparency() {
+        glDeleteVertexArrays(1, &emptyVao);
+        glDeleteFramebuffers(1, &framebuffer);
+        glDeleteTextures(1, &accumulationTexture);
+        glDeleteTextures(1, &revealageTexture);
+        glDeleteTextures(1, &depthTexture);
+        glDeleteTextures(1, &headPointerTexture);
+        glDeleteBuffers(1, &nodeBuffer);
+        glDeleteBuffers(1, &nodeCountBuffer);
+    }
+	HairTransparency(const HairTransparency&) = delete;
+	HairTransparency& operator=(const HairTransparency&) = delete;
+
+	static std::vector<std::string> getDefines(TransparencyMode mode) {
+        if (mode == TransparencyMode::WeightedBlended)
+            return { "WEIGHTED_OIT" };
+        if (mode == TransparencyMode::LinkedList)
+            return { "LINKED_LIST_OIT" };
+        return {};
+    }
+
+	// Sets the uniforms of a hair shader compiled with getDefines, which has to be in use
+	void apply(const Shader& shader) const {
+        shader.setFloat("strandAlpha", strandAlpha);
+        if (mode == TransparencyMode::LinkedList)
+            shader.setUint("maxNodeCount", maxNodeCount);
+    }
+
+	void begin();
+	void end();
+
+	void setStrandAlpha(float alpha) { strandAlpha = alpha; }
+	void setProfiler(GpuProfiler* _profiler) { profiler = _profiler; }
+	TransparencyMode getMode() const { return mode; }
+
+private:
+	TransparencyMode mode;
+	glm::ivec2 size;
+	DrawingShader resolveShader;
+	GLuint emptyVao = GL_NONE;
+	float strandAlpha = 0.35f;
+	GLboolean blendWasEnabled = GL_FALSE;
+	GLint targetFramebuffer = 0;				// Framebuffer bound at begin, the default one or an offscreen target
+	GpuProfiler* profiler = nullptr;
+
+	// Weighted blended targets
+	GLuint framebuffer = GL_NONE;
+	GLuint accumulationTexture = GL_NONE;
+	GLuint revealageTexture = GL_NONE;
+	GLuint depthTexture = GL_NONE;
+
+	// Linked list storage
+	GLuint headPointerTexture = GL_NONE;
+	GLuint nodeBuffer = GL_NONE;
+	GLuint nodeCountBuffer = GL_NONE;
+	uint32_t maxNodeCount = 0;
+};
+
+inline void HairTransparency::begin()
+{
+    if (mode == TransparencyMode::Opaque)
+        return;
+
+    blendWasEnabled = glIsEnabled(GL_BLEND);
+    glGetIntegerv(GL_DRAW_FRAMEBUFFER_BINDING, &targetFramebuffer);
+    glDepthMask(GL_FALSE);
+    if (mode == TransparencyMode::WeightedBlended)
+    {
+        const float noAccumulation[] = { 0.f, 0.f, 0.f, 0.f };
+        const float fullRevealage[] = { 1.f, 1.f, 1.f, 1.f };
+        glClearNamedFramebufferfv(framebuffer, GL_COLOR, 0, noAccumulation);
+        glClearNamedFramebufferfv(framebuffer, GL_COLOR, 1, fullRevealage);
+        glBlitNamedFramebuffer(targetFramebuffer, framebuffer, 0, 0, size.x, size.y, 0, 0, size.x, size.y, GL_DEPTH_BUFFER_BIT, GL_NEAREST);
+        glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+        glEnable(GL_BLEND);
+        glBlendFunci(0, GL_ONE, GL_ONE);
+        glBlendFunci(1, GL_ZERO, GL_ONE_MINUS_SRC_COLOR);
+    }
+    else
+    {
+        const GLuint endOfList = 0xFFFFFFFFU;
+        const GLuint zero = 0;
+        glClearTexImage(headPointerTexture, 0, GL_RED_INTEGER, GL_UNSIGNED_INT, &endOfList);
+        glClearNamedBufferData(nodeCountBuffer, GL_R32UI, GL_RED_INTEGER, GL_UNSIGNED_INT, &zero);
+        glBindImageTexture(TRANSPARENCY_HEAD_POINTER_IMAGE_UNIT, headPointerTexture, 0, GL_FALSE, 0, GL_READ_WRITE, GL_R32UI);
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 16, nodeBuffer);
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 17, nodeCountBuffer);
+        glMemoryBarrier(GL_SHADER_IMAGE_ACCESS_BARRIER_BIT | GL_SHADER_STORAGE_BARRIER_BIT);
+        glColorMask(GL_FALSE, GL_FALSE, GL_FALSE, GL_FALSE);
+    }
+}
+
+inline void HairTransparency::end()
+{
+    if (mode == TransparencyMode::Opaque)
+        return;
+
+    if (profiler) profiler->begin("Transparency resolve");
+    if (mode == TransparencyMode::WeightedBlended)
+    {
+        glBindFramebuffer(GL_FRAMEBUFFER, targetFramebuffer);
+        glBindTextureUnit(TRANSPARENCY_ACCUMULATION_TEXTURE_UNIT, accumulationTexture);
+        glBindTextureUnit(TRANSPARENCY_REVEALAGE_TEXTURE_UNIT, revealageTexture);
+    }
+    else
+    {
+        glColorMask(GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE);
+        glMemoryBarrier(GL_SHADER_IMAGE_ACCESS_BARRIER_BIT | GL_SHADER_STORAGE_BARRIER_BIT);
+    }
+
+    glEnable(GL_BLEND);
+    glBlendFunc(GL_ONE, GL_SRC_ALPHA);
+    glDisable(GL_DEPTH_TEST);
+    resolveShader.use();
+    glBindVertexArray(emptyVao);
+    glDrawArrays(GL_TRIANGLES, 0, 3);
+    glBindVertexArray(GL_NONE);
+    if (profiler) profiler->end("Transparency resolve");
+
+    glEnable(GL_DEPTH_TEST);
+    glDepthMask(GL_TRUE);
+    glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+    if (!blendWasEnabled)
+        glDisable(GL_BLEND);
+}
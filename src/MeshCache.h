@@ -0,0 +1,92 @@
+#pragma once
+#include "MappedFile.h"
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <memory>
+#include <string>
+#include <vector>
+
+// Binary cache of a mesh that is ready for upload: interleaved vertices and optimized indices. The header holds
+// a hash of everything the data was derived from, the size and modification time of the source file and the load
+// transform, so a changed model or transform rebuilds the cache without the source being read to validate it. A
+// valid cache is memory mapped and handed to the GL upload without copying.
+class MeshCache {
+public:
+	static constexpr uint32_t MAGIC = 0x48534D48U;		// "HMSH"
+	static constexpr uint32_t VERSION = 3U;				// Increment when the layout or the preprocessing changes
+	static constexpr uint64_t HASH_SEED = 0xCBF29CE484222325ULL;
+
+	struct Header {
+		uint32_t magic;
+		uint32_t version;
+		uint64_t sourceHash;
+		uint32_t floatsPerVertex;
+		uint32_t vertexCount;
+		uint32_t indexCount;
+		uint32_t padding;
+	};
+
+	// 64-bit FNV-1a, chained through the seed to hash several inputs
+	static uint64_t hash(const void* data, size_t size, uint64_t seed = HASH_SEED) {
+        const uint8_t* bytes = static_cast<const uint8_t*>(data);
+        uint64_t result = seed;
+        for (size_t i = 0; i < size; ++i)
+        {
+            result = (result ^ bytes[i]) * 0x100000001B3ULL;
+        }
+        return result;
+    }
+
+	// Identifies a version of a file by its size and modification time, fails when the file doesn't exist
+	static bool hashFileStamp(const std::string& path, uint64_t& result, uint64_t seed = HASH_SEED) {
+        std::error_code error;
+        const uint64_t size = std::filesystem::file_size(path, error);
+        if (error)
+            return false;
+        const auto writeTime = std::filesystem::last_write_time(path, error).time_since_epoch().count();
+        if (error)
+            return false;
+        result = hash(&size, sizeof(size), seed);
+        result = hash(&writeTime, sizeof(writeTime), result);
+        return true;
+    }
+
+	// Maps the cache and keeps it mapped, fails when the file is missing, truncated or built from other inputs
+	bool load(const std::string& path, uint64_t sourceHash, uint32_t floatsPerVertex) {
+        file = std::make_unique<MappedFile>(path);
+        if (!file->isValid() || file->getSize() < sizeof(Header))
+            return false;
+
+        std::memcpy(&header, file->getData(), sizeof(Header));
+        const size_t expectedSize = sizeof(Header) + static_cast<size_t>(header.vertexCount) * header.floatsPerVertex * sizeof(float) +
+            static_cast<size_t>(header.indexCount) * sizeof(uint32_t);
+        return header.magic == MAGIC && header.version == VERSION && header.sourceHash == sourceHash &&
+            header.floatsPerVertex == floatsPerVertex && file->getSize() == expectedSize;
+    }
+
+	static bool write(const std::string& path, uint64_t sourceHash, uint32_t floatsPerVertex,
+		const std::vector<float>& vertices, const std::vector<uint32_t>& indices) {
+        std::ofstream stream(path, std::ios::binary | std::ios::trunc);
+        if (!stream)
+            return false;
+
+        const Header fileHeader = { MAGIC, VERSION, sourceHash, floatsPerVertex,
+            static_cast<uint32_t>(vertices.size() / floatsPerVertex), static_cast<uint32_t>(indices.size()), 0 };
+        stream.write(reinterpret_cast<const char*>(&fileHeader), sizeof(Header));
+        stream.write(reinterpret_cast<const char*>(vertices.data()), vertices.size() * sizeof(float));
+        stream.write(reinterpret_cast<const char*>(indices.data()), indices.size() * sizeof(uint32_t));
+        return static_cast<bool>(stream);
+    }
+
+	// Valid after a successful load, point into the mapping
+	const float* getVertices() const { return reinterpret_cast<const float*>(file->getData() + sizeof(Header)); }
+	const uint32_t* getIndices() const { return reinterpret_cast<const uint32_t*>(getVertices() + static_cast<size_t>(header.vertexCount) * header.floatsPerVertex); }
+	uint32_t getVertexCount() const { return header.vertexCount; }
+	uint32_t getIndexCount() const { return header.indexCount; }
+
+private:
+	std::unique_ptr<MappedFile> file;
+	Header header{};
+};
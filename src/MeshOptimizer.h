@@ -0,0 +1,212 @@
+#pragma once
+#include <glm/glm.hpp>
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <numeric>
+#include <vector>
+
+// Index buffer reordering run once at load. Triangles are first ordered for the post-transform vertex cache with
+// Forsyth's linear-speed algorithm, then the ordered sequence is cut into clusters that are sorted so outward facing
+// parts of the mesh come first and occlude the rest, in the spirit of Tipsify's overdraw pass.
+class MeshOptimizer {
+public:
+	static constexpr uint32_t CACHE_SIZE = 32;
+	static constexpr uint32_t CLUSTER_TRIANGLE_COUNT = 256;
+
+	static std::vector<uint32_t> optimizeVertexCache(const std::vector<uint32_t>& indices, uint32_t vertexCount);
+	static std::vector<uint32_t> optimizeOverdraw(const std::vector<uint32_t>& indices, const std::vector<glm::vec3>& positions);
+
+	// Average vertex shader invocations per triangle with a FIFO cache, 0.5 is ideal for large regular meshes, 3 is the worst
+	static float computeAcmr(const std::vector<uint32_t>& indices, uint32_t cacheSize = CACHE_SIZE) {
+        std::vector<uint32_t> cache;
+        uint32_t misses = 0;
+        for (uint32_t index : indices)
+        {
+            if (std::find(cache.begin(), cache.end(), index) != cache.end())
+                continue;
+
+            ++misses;
+            cache.push_back(index);
+            if (cache.size() > cacheSize)
+                cache.erase(cache.begin());
+        }
+        return indices.empty() ? 0.f : static_cast<float>(misses) / (indices.size() / 3);
+    }
+
+private:
+	static float vertexScore(int32_t cachePosition, uint32_t remainingTriangles) {
+        if (remainingTriangles == 0)
+            return -1.f;
+
+        float score = 0.f;
+        if (cachePosition >= 0)
+        {
+            // The last triangle's vertices get a fixed score so the next triangle doesn't simply reuse them all
+            if (cachePosition < 3)
+                score = 0.75f;
+            else
+                score = std::pow(1.f - (cachePosition - 3) / static_cast<float>(CACHE_SIZE - 3), 1.5f);
+        }
+
+        // Vertices with few triangles left are finished first, so they don't get stranded outside the cache
+        return score + 2.f * std::pow(static_cast<float>(remainingTriangles), -0.5f);
+    }
+};
+
+inline std::vector<uint32_t> MeshOptimizer::optimizeVertexCache(const std::vector<uint32_t>& indices, uint32_t vertexCount)
+{
+    const uint32_t triangleCount = static_cast<uint32_t>(indices.size() / 3);
+    std::vector<uint32_t> remainingTriangles(vertexCount, 0);
+    for (uint32_t index : indices)
+    {
+        ++remainingTriangles[index];
+    }
+
+    // Triangles of every vertex, in one flat array
+    std::vector<uint32_t> triangleOffsets(vertexCount + 1, 0);
+    for (uint32_t i = 0; i < vertexCount; ++i)
+    {
+        triangleOffsets[i + 1] = triangleOffsets[i] + remainingTriangles[i];
+    }
+    std::vector<uint32_t> vertexTriangles(indices.size());
+    std::vector<uint32_t> fill(triangleOffsets.begin(), triangleOffsets.end() - 1);
+    for (uint32_t i = 0; i < indices.size(); ++i)
+    {
+        vertexTriangles[fill[indices[i]]++] = i / 3;
+    }
+
+    std::vector<float> vertexScores(vertexCount);
+    for (uint32_t i = 0; i < vertexCount; ++i)
+    {
+        vertexScores[i] = vertexScore(-1, remainingTriangles[i]);
+    }
+    std::vector<float> triangleScores(triangleCount);
+    for (uint32_t i = 0; i < triangleCount; ++i)
+    {
+        triangleScores[i] = vertexScores[indices[i * 3]] + vertexScores[indices[i * 3 + 1]] + vertexScores[indices[i * 3 + 2]];
+    }
+
+    std::vector<bool> emitted(triangleCount, false);
+    std::vector<uint32_t> cache;
+    std::vector<uint32_t> optimized;
+    optimized.reserve(indices.size());
+    uint32_t scanCursor = 0;
+    int64_t bestTriangle = triangleCount > 0 ? std::max_element(triangleScores.begin(), triangleScores.end()) - triangleScores.begin() : -1;
+    while (bestTriangle >= 0)
+    {
+        emitted[bestTriangle] = true;
+        std::vector<uint32_t> newCache;
+        for (uint32_t corner = 0; corner < 3; ++corner)
+        {
+            const uint32_t vertex = indices[bestTriangle * 3 + corner];
+            optimized.push_back(vertex);
+            newCache.push_back(vertex);
+            --remainingTriangles[vertex];
+
+            // Move the emitted triangle to the end of the vertex's list, past the triangles still to be drawn
+            uint32_t* first = &vertexTriangles[triangleOffsets[vertex]];
+            uint32_t* last = first + remainingTriangles[vertex];
+            std::swap(*std::find(first, last + 1, static_cast<uint32_t>(bestTriangle)), *last);
+        }
+        for (uint32_t vertex : cache)
+        {
+            if (std::find(newCache.begin(), newCache.end(), vertex) == newCache.end())
+                newCache.push_back(vertex);
+        }
+
+        // Vertices pushed out of the cache lose their position score, the rest are rescored by position
+        for (uint32_t i = CACHE_SIZE; i < newCache.size(); ++i)
+        {
+            vertexScores[newCache[i]] = vertexScore(-1, remainingTriangles[newCache[i]]);
+        }
+        newCache.resize(std::min<size_t>(newCache.size(), CACHE_SIZE));
+        for (uint32_t i = 0; i < newCache.size(); ++i)
+        {
+            vertexScores[newCache[i]] = vertexScore(static_cast<int32_t>(i), remainingTriangles[newCache[i]]);
+        }
+        cache.swap(newCache);
+
+        // The next triangle is the best one touching the cache, only those changed score
+        bestTriangle = -1;
+        float bestScore = -1.f;
+        for (uint32_t vertex : cache)
+        {
+            for (uint32_t i = 0; i < remainingTriangles[vertex]; ++i)
+            {
+                const uint32_t triangle = vertexTriangles[triangleOffsets[vertex] + i];
+                const float score = vertexScores[indices[triangle * 3]] + vertexScores[indices[triangle * 3 + 1]] +
+                    vertexScores[indices[triangle * 3 + 2]];
+                triangleScores[triangle] = score;
+                if (score > bestScore)
+                {
+                    bestScore = score;
+                    bestTriangle = triangle;
+                }
+            }
+        }
+
+        // Nothing left around the cache, continue with the next triangle that hasn't been drawn
+        if (bestTriangle < 0)
+        {
+            while (scanCursor < triangleCount && emitted[scanCursor])
+                ++scanCursor;
+            if (scanCursor < triangleCount)
+                bestTriangle = scanCursor;
+        }
+    }
+
+    return optimized;
+}
+
+inline std::vector<uint32_t> MeshOptimizer::optimizeOverdraw(const std::vector<uint32_t>& indices, const std::vector<glm::vec3>& positions)
+{
+    const uint32_t triangleCount = static_cast<uint32_t>(indices.size() / 3);
+    const uint32_t clusterCount = (triangleCount + CLUSTER_TRIANGLE_COUNT - 1) / CLUSTER_TRIANGLE_COUNT;
+    if (clusterCount <= 1)
+        return indices;
+
+    glm::vec3 meshCenter(0.f);
+    for (uint32_t index : indices)
+    {
+        meshCenter += positions[index];
+    }
+    meshCenter /= static_cast<float>(indices.size());
+
+    // Clusters that face away from the mesh center are likely in front of the rest from any view direction
+    std::vector<float> occlusionPotentials(clusterCount);
+    for (uint32_t cluster = 0; cluster < clusterCount; ++cluster)
+    {
+        glm::vec3 center(0.f);
+        glm::vec3 areaWeightedNormal(0.f);
+        const uint32_t firstTriangle = cluster * CLUSTER_TRIANGLE_COUNT;
+        const uint32_t lastTriangle = std::min(firstTriangle + CLUSTER_TRIANGLE_COUNT, triangleCount);
+        for (uint32_t triangle = firstTriangle; triangle < lastTriangle; ++triangle)
+        {
+            const glm::vec3& a = positions[indices[triangle * 3]];
+            const glm::vec3& b = positions[indices[triangle * 3 + 1]];
+            const glm::vec3& c = positions[indices[triangle * 3 + 2]];
+            center += (a + b + c) / 3.f;
+            areaWeightedNormal += glm::cross(b - a, c - a);
+        }
+        center /= static_cast<float>(lastTriangle - firstTriangle);
+        const float normalLength = glm::length(areaWeightedNormal);
+        occlusionPotentials[cluster] = normalLength > 0.f ? glm::dot(center - meshCenter, areaWeightedNormal / normalLength) : 0.f;
+    }
+
+    std::vector<uint32_t> clusterOrder(clusterCount);
+    std::iota(clusterOrder.begin(), clusterOrder.end(), 0);
+    std::stable_sort(clusterOrder.begin(), clusterOrder.end(), [&occlusionPotentials](uint32_t a, uint32_t b) {
+        return occlusionPotentials[a] > occlusionPotentials[b];
+    });
+
+    std::vector<uint32_t> sorted;
+    sorted.reserve(indices.size());
+    for (uint32_t cluster : clusterOrder)
+    {
+        const auto first = indices.begin() + cluster * CLUSTER_TRIANGLE_COUNT * 3;
+        const auto last = indices.begin() + std::min<size_t>((cluster + 1) * CLUSTER_TRIANGLE_COUNT * 3, indices.size());
+        sorted.insert(sorted.end(), first, last);
+    }
+    return sorted;
+}
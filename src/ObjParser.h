@@ -0,0 +1,236 @@
+#pragma once
+#include "MappedFile.h"
+#include <algorithm>
+#include <array>
+#include <charconv>
+#include <cstdint>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Interleaved position and normal per vertex, a vertex for every distinct position and normal pair
+struct ObjMesh {
+	std::vector<float> vertices;
+	std::vector<uint32_t> indices;
+
+	uint32_t getVertexCount() const { return static_cast<uint32_t>(vertices.size() / 6); }
+};
+
+// Loader for the subset of Wavefront OBJ the application uses: positions, normals and polygonal faces, everything
+// else is skipped. The file is memory mapped and split into line aligned chunks that are parsed in parallel with
+// std::from_chars, then the chunks are merged and the faces are triangulated as fans. Relative (negative) indices
+// are supported, faces without normals get zero normals.
+class ObjParser {
+public:
+	static bool parse(const std::string& path, ObjMesh& mesh, uint32_t threadCount = 0);
+
+private:
+	struct Corner {
+		int32_t position;
+		int32_t normal;			// -1 when the face has no normals
+	};
+
+	struct Chunk {
+		const char* begin = nullptr;
+		const char* end = nullptr;
+		std::vector<float> positions;
+		std::vector<float> normals;
+		std::vector<Corner> corners;			// Fan triangulated, three per triangle
+		std::vector<uint32_t> relativeCorners;	// Corner index << 2 | relative components, which still miss the preceding chunks
+		bool valid = true;
+	};
+
+	static void parseChunk(Chunk& chunk);
+
+	static const char* skipSpaces(const char* cursor, const char* end) {
+        while (cursor < end && (*cursor == ' ' || *cursor == '\t'))
+            ++cursor;
+        return cursor;
+    }
+	static const char* parseFloats(const char* cursor, const char* end, std::vector<float>& values, bool& valid) {
+        for (int i = 0; i < 3; ++i)
+        {
+            float value = 0.f;
+            cursor = skipSpaces(cursor, end);
+            // from_chars doesn't accept a leading plus sign
+            if (cursor < end && *cursor == '+')
+                ++cursor;
+            const auto result = std::from_chars(cursor, end, value);
+            valid &= result.ec == std::errc();
+            values.push_back(value);
+            cursor = result.ptr;
+        }
+        return cursor;
+    }
+};
+
+inline bool ObjParser::parse(const std::string& path, ObjMesh& mesh, uint32_t threadCount)
+{
+    MappedFile file(path);
+    if (!file.isValid())
+        return false;
+
+    if (threadCount == 0)
+        threadCount = std::max(1U, std::thread::hardware_concurrency());
+    // Every chunk holds at least one byte, so the line search never reads before the mapping
+    threadCount = static_cast<uint32_t>(std::max<size_t>(1, std::min<size_t>(threadCount, file.getSize())));
+    const char* fileBegin = reinterpret_cast<const char*>(file.getData());
+    const char* fileEnd = fileBegin + file.getSize();
+
+    // Chunks of equal size, each moved forward to the start of a line
+    std::vector<Chunk> chunks(threadCount);
+    for (uint32_t i = 0; i < threadCount; ++i)
+    {
+        chunks[i].begin = i == 0 ? fileBegin : chunks[i - 1].end;
+        const char* end = i + 1 == threadCount ? fileEnd : std::max(chunks[i].begin, fileBegin + file.getSize() * (i + 1) / threadCount);
+        while (end < fileEnd && end[-1] != '\n')
+            ++end;
+        chunks[i].end = end;
+    }
+
+    std::vector<std::thread> workers;
+    for (uint32_t i = 1; i < threadCount; ++i)
+    {
+        workers.emplace_back(&ObjParser::parseChunk, std::ref(chunks[i]));
+    }
+    parseChunk(chunks[0]);
+    for (auto& worker : workers)
+    {
+        worker.join();
+    }
+
+    // Indices become global once the counts of the preceding chunks are known
+    size_t positionCount = 0;
+    size_t normalCount = 0;
+    size_t cornerCount = 0;
+    for (auto& chunk : chunks)
+    {
+        if (!chunk.valid)
+            return false;
+        for (uint32_t relativeCorner : chunk.relativeCorners)
+        {
+            Corner& corner = chunk.corners[relativeCorner >> 2];
+            if (relativeCorner & 1)
+                corner.position += static_cast<int32_t>(positionCount);
+            if (relativeCorner & 2)
+                corner.normal += static_cast<int32_t>(normalCount);
+        }
+        positionCount += chunk.positions.size() / 3;
+        normalCount += chunk.normals.size() / 3;
+        cornerCount += chunk.corners.size();
+    }
+
+    std::vector<float> positions;
+    std::vector<float> normals;
+    positions.reserve(positionCount * 3);
+    normals.reserve(normalCount * 3);
+    for (const auto& chunk : chunks)
+    {
+        positions.insert(positions.end(), chunk.positions.begin(), chunk.positions.end());
+        normals.insert(normals.end(), chunk.normals.begin(), chunk.normals.end());
+    }
+
+    // A vertex per distinct position and normal pair, in order of first use. Most positions have a single normal,
+    // so the pairs are found through a list per position instead of a hash map.
+    const uint32_t noVertex = UINT32_MAX;
+    std::vector<uint32_t> firstVertexOfPosition(positionCount, noVertex);
+    std::vector<uint32_t> nextVertexOfPosition;
+    std::vector<int32_t> vertexNormals;
+    mesh.vertices.clear();
+    mesh.indices.clear();
+    mesh.vertices.reserve(positionCount * 6);
+    mesh.indices.reserve(cornerCount);
+    for (const auto& chunk : chunks)
+    {
+        for (const Corner& corner : chunk.corners)
+        {
+            if (corner.position < 0 || static_cast<size_t>(corner.position) >= positionCount || static_cast<size_t>(corner.normal + 1) > normalCount)
+                return false;
+
+            uint32_t vertex = firstVertexOfPosition[corner.position];
+            uint32_t previous = noVertex;
+            while (vertex != noVertex && vertexNormals[vertex] != corner.normal)
+            {
+                previous = vertex;
+                vertex = nextVertexOfPosition[vertex];
+            }
+            if (vertex == noVertex)
+            {
+                vertex = static_cast<uint32_t>(vertexNormals.size());
+                vertexNormals.push_back(corner.normal);
+                nextVertexOfPosition.push_back(noVertex);
+                (previous == noVertex ? firstVertexOfPosition[corner.position] : nextVertexOfPosition[previous]) = vertex;
+
+                const float* position = &positions[corner.position * 3];
+                const std::array<float, 3> noNormal = { 0.f, 0.f, 0.f };
+                const float* normal = corner.normal >= 0 ? &normals[corner.normal * 3] : noNormal.data();
+                mesh.vertices.insert(mesh.vertices.end(), { position[0], position[1], position[2], normal[0], normal[1], normal[2] });
+            }
+            mesh.indices.push_back(vertex);
+        }
+    }
+    return true;
+}
+
+inline void ObjParser::parseChunk(Chunk& chunk)
+{
+    std::vector<Corner> polygon;
+    std::vector<uint32_t> polygonRelativeMasks;
+    const char* cursor = chunk.begin;
+    while (cursor < chunk.end)
+    {
+        const char* lineEnd = std::find(cursor, chunk.end, '\n');
+        cursor = skipSpaces(cursor, lineEnd);
+        if (lineEnd - cursor > 2 && cursor[0] == 'v' && (cursor[1] == ' ' || cursor[1] == '\t'))
+        {
+            parseFloats(cursor + 2, lineEnd, chunk.positions, chunk.valid);
+        }
+        else if (lineEnd - cursor > 3 && cursor[0] == 'v' && cursor[1] == 'n' && (cursor[2] == ' ' || cursor[2] == '\t'))
+        {
+            parseFloats(cursor + 3, lineEnd, chunk.normals, chunk.valid);
+        }
+        else if (lineEnd - cursor > 2 && cursor[0] == 'f' && (cursor[1] == ' ' || cursor[1] == '\t'))
+        {
+            // Corners are position[/texture[/normal]], the texture coordinate is skipped
+            polygon.clear();
+            polygonRelativeMasks.clear();
+            cursor = skipSpaces(cursor + 2, lineEnd);
+            while (cursor < lineEnd && *cursor != '\r' && *cursor != '#')
+            {
+                int32_t indices[3] = { 0, 0, 0 };
+                for (int component = 0; component < 3 && cursor < lineEnd; ++component)
+                {
+                    const auto result = std::from_chars(cursor, lineEnd, indices[component]);
+                    cursor = result.ptr;
+                    if (cursor == lineEnd || *cursor != '/')
+                        break;
+                    ++cursor;
+                }
+                if (indices[0] == 0)
+                {
+                    chunk.valid = false;
+                    return;
+                }
+
+                // OBJ indices start at 1, negative ones count back from the last element defined so far
+                Corner corner;
+                corner.position = indices[0] > 0 ? indices[0] - 1 : static_cast<int32_t>(chunk.positions.size() / 3) + indices[0];
+                corner.normal = indices[2] > 0 ? indices[2] - 1 : indices[2] < 0 ? static_cast<int32_t>(chunk.normals.size() / 3) + indices[2] : -1;
+                polygon.push_back(corner);
+                polygonRelativeMasks.push_back((indices[0] < 0 ? 1U : 0U) | (indices[2] < 0 ? 2U : 0U));
+                cursor = skipSpaces(cursor, lineEnd);
+            }
+
+            for (size_t i = 2; i < polygon.size(); ++i)
+            {
+                for (size_t polygonCorner : { size_t(0), i - 1, i })
+                {
+                    if (polygonRelativeMasks[polygonCorner] != 0)
+                        chunk.relativeCorners.push_back(static_cast<uint32_t>(chunk.corners.size()) << 2 | polygonRelativeMasks[polygonCorner]);
+                    chunk.corners.push_back(polygon[polygonCorner]);
+                }
+            }
+        }
+        cursor = lineEnd + 1;
+    }
+}
@@ -0,0 +1,130 @@
+#pragma once
+#include <glad/glad.h>
+#include "MappedFile.h"
+#include "MeshCache.h"
+#include "PathConfig.h"
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+
+// Linked program binaries from glGetProgramBinary, one file per program in a directory per driver. A program is keyed
+// by a hash of the stage types and their sources with the defines inserted, so an edited shader or a new variant
+// misses the cache and is compiled as before. The directory is named after a hash of the vendor, renderer and
+// version strings, and the driver may still reject a binary after an update, in both cases the program is compiled
+// and the cache entry is rewritten.
+class ProgramCache {
+public:
+	static constexpr uint32_t MAGIC = 0x47525048U;		// "HPRG"
+	static constexpr uint32_t VERSION = 1U;				// Increment when the layout changes
+
+	struct Header {
+		uint32_t magic;
+		uint32_t version;
+		uint64_t programHash;
+		uint32_t binaryFormat;
+		uint32_t binarySize;
+	};
+
+	static void setEnabled(bool _enabled) { getState().enabled = _enabled; }
+	// Programs loaded from the cache and compiled since startup, and the time spent building both
+	static uint32_t getLoadedCount() { return getState().loadedCount; }
+	static uint32_t getCompiledCount() { return getState().compiledCount; }
+	static double getBuildTime() { return getState().buildTime; }
+	static void recordBuild(bool loaded, double milliseconds) {
+        State& state = getState();
+        ++(loaded ? state.loadedCount : state.compiledCount);
+        state.buildTime += milliseconds;
+    }
+
+	// Replaces the program's code with the cached binary, fails when there is none or the driver rejects it
+	static bool load(GLuint program, uint64_t programHash) {
+        if (!isAvailable())
+            return false;
+
+        const MappedFile file(getPath(programHash));
+        Header header;
+        if (!file.isValid() || file.getSize() < sizeof(Header))
+            return false;
+        std::memcpy(&header, file.getData(), sizeof(Header));
+        if (header.magic != MAGIC || header.version != VERSION || header.programHash != programHash ||
+            file.getSize() != sizeof(Header) + header.binarySize)
+            return false;
+
+        glProgramBinary(program, header.binaryFormat, file.getData() + sizeof(Header), static_cast<GLsizei>(header.binarySize));
+        GLint success;
+        glGetProgramiv(program, GL_LINK_STATUS, &success);
+        return success;
+    }
+
+	// Writes the binary of a linked program that was created with GL_PROGRAM_BINARY_RETRIEVABLE_HINT
+	static void store(GLuint program, uint64_t programHash) {
+        if (!isAvailable())
+            return;
+
+        GLint binarySize = 0;
+        glGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH, &binarySize);
+        if (binarySize <= 0)
+            return;
+        std::vector<uint8_t> binary(binarySize);
+        GLenum binaryFormat;
+        glGetProgramBinary(program, binarySize, &binarySize, &binaryFormat, binary.data());
+
+        std::error_code error;
+        std::filesystem::create_directories(getDirectory(), error);
+        const Header header = { MAGIC, VERSION, programHash, binaryFormat, static_cast<uint32_t>(binarySize) };
+        std::ofstream stream(getPath(programHash), std::ios::binary | std::ios::trunc);
+        stream.write(reinterpret_cast<const char*>(&header), sizeof(Header));
+        stream.write(reinterpret_cast<const char*>(binary.data()), binarySize);
+        if (!stream)
+            std::cout << "Failed to write the program cache " << getPath(programHash) << std::endl;
+    }
+
+	// False when caching is disabled or the driver offers no binary formats
+	static bool isAvailable() {
+        State& state = getState();
+        if (state.formatCount < 0)
+            glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &state.formatCount);
+        return state.enabled && state.formatCount > 0;
+    }
+
+private:
+	struct State {
+		bool enabled = true;
+		GLint formatCount = -1;			// Queried on first use, a context has to be current
+		std::string directory;
+		uint32_t loadedCount = 0;
+		uint32_t compiledCount = 0;
+		double buildTime = 0.0;
+	};
+
+	static State& getState() {
+        static State state;
+        return state;
+    }
+	static std::string toHex(uint64_t value) {
+        char text[17];
+        std::snprintf(text, sizeof(text), "%016llx", static_cast<unsigned long long>(value));
+        return text;
+    }
+	static const std::string& getDirectory() {
+        State& state = getState();
+        if (state.directory.empty())
+        {
+            uint64_t driverHash = MeshCache::HASH_SEED;
+            for (GLenum name : { GL_VENDOR, GL_RENDERER, GL_VERSION })
+            {
+                const char* value = reinterpret_cast<const char*>(glGetString(name));
+                const std::string text = value ? value : "";
+                driverHash = MeshCache::hash(text.data(), text.size() + 1, driverHash);
+            }
+            state.directory = CACHE_FOLDER + "Programs/" + toHex(driverHash) + "/";
+        }
+        return state.directory;
+    }
+	static std::string getPath(uint64_t programHash) { return getDirectory() + toHex(programHash) + ".program"; }
+};
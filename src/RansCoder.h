@@ -0,0 +1,142 @@
+#pragma once
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <vector>
+
+// Order-0 range asymmetric numeral system coder over bytes, with 32-bit state and byte-wise renormalization.
+// The symbol frequencies are normalized to a power of two so decoding is a table lookup, a multiply and a shift
+// per byte. The frequency table isn't part of the encoded bytes, the caller stores it next to them.
+class RansCoder {
+public:
+	static constexpr uint32_t SCALE_BITS = 12;
+	static constexpr uint32_t SCALE = 1U << SCALE_BITS;	// Sum of the normalized frequencies
+	using Frequencies = std::array<uint16_t, 256>;
+
+	// Counts the bytes and scales the counts to SCALE, every byte that occurs keeps a frequency of at least one
+	static Frequencies normalize(const std::vector<uint8_t>& symbols);
+	// Appends the encoded bytes to output, symbols has to be non-empty and only contain bytes of the frequencies
+	static void encode(const std::vector<uint8_t>& symbols, const Frequencies& frequencies, std::vector<uint8_t>& output);
+	// Decodes symbolCount bytes, fails when the input ends before them
+	static bool decode(const uint8_t* input, size_t inputSize, const Frequencies& frequencies, uint8_t* symbols, size_t symbolCount);
+
+private:
+	static constexpr uint32_t LOWER_BOUND = 1U << 23;	// The state stays in [LOWER_BOUND, LOWER_BOUND << 8)
+};
+
+inline RansCoder::Frequencies RansCoder::normalize(const std::vector<uint8_t>& symbols)
+{
+    std::array<uint64_t, 256> counts{};
+    for (uint8_t symbol : symbols)
+    {
+        ++counts[symbol];
+    }
+
+    Frequencies frequencies{};
+    uint32_t sum = 0;
+    for (uint32_t symbol = 0; symbol < 256; ++symbol)
+    {
+        if (counts[symbol] == 0)
+            continue;
+        frequencies[symbol] = static_cast<uint16_t>(std::max<uint64_t>(1, counts[symbol] * SCALE / symbols.size()));
+        sum += frequencies[symbol];
+    }
+
+    // Rounding leaves the sum off by at most a few symbols, the difference goes to or comes from the most frequent ones
+    while (sum != SCALE && !symbols.empty())
+    {
+        uint32_t largest = 0;
+        for (uint32_t symbol = 1; symbol < 256; ++symbol)
+        {
+            if (frequencies[symbol] > frequencies[largest])
+                largest = symbol;
+        }
+        if (sum < SCALE)
+        {
+            frequencies[largest] = static_cast<uint16_t>(frequencies[largest] + SCALE - sum);
+            sum = SCALE;
+        }
+        else
+        {
+            const uint32_t decrease = std::min<uint32_t>(sum - SCALE, frequencies[largest] / 2);
+            frequencies[largest] = static_cast<uint16_t>(frequencies[largest] - decrease);
+            sum -= decrease;
+        }
+    }
+    return frequencies;
+}
+
+inline void RansCoder::encode(const std::vector<uint8_t>& symbols, const Frequencies& frequencies, std::vector<uint8_t>& output)
+{
+    std::array<uint32_t, 256> starts;
+    uint32_t start = 0;
+    for (uint32_t symbol = 0; symbol < 256; ++symbol)
+    {
+        starts[symbol] = start;
+        start += frequencies[symbol];
+    }
+
+    // The decoder reads forwards, so the symbols are encoded backwards into a buffer filled from its end.
+    // Every symbol emits at most two bytes.
+    std::vector<uint8_t> buffer(symbols.size() * 2 + sizeof(uint32_t));
+    uint8_t* cursor = buffer.data() + buffer.size();
+    uint32_t state = LOWER_BOUND;
+    for (size_t i = symbols.size(); i-- > 0;)
+    {
+        const uint32_t frequency = frequencies[symbols[i]];
+        const uint32_t stateLimit = ((LOWER_BOUND >> SCALE_BITS) << 8) * frequency;
+        while (state >= stateLimit)
+        {
+            *--cursor = static_cast<uint8_t>(state & 0xFF);
+            state >>= 8;
+        }
+        state = ((state / frequency) << SCALE_BITS) + (state % frequency) + starts[symbols[i]];
+    }
+    for (int shift = 0; shift < 32; shift += 8)
+    {
+        *--cursor = static_cast<uint8_t>(state >> shift);
+    }
+    output.insert(output.end(), cursor, buffer.data() + buffer.size());
+}
+
+inline bool RansCoder::decode(const uint8_t* input, size_t inputSize, const Frequencies& frequencies, uint8_t* symbols, size_t symbolCount)
+{
+    if (inputSize < sizeof(uint32_t))
+        return symbolCount == 0;
+
+    std::array<uint32_t, 256> starts;
+    std::array<uint8_t, SCALE> symbolOfSlot;
+    uint32_t start = 0;
+    for (uint32_t symbol = 0; symbol < 256; ++symbol)
+    {
+        starts[symbol] = start;
+        for (uint32_t slot = start; slot < start + frequencies[symbol] && slot < SCALE; ++slot)
+        {
+            symbolOfSlot[slot] = static_cast<uint8_t>(symbol);
+        }
+        start += frequencies[symbol];
+    }
+    if (start != SCALE)
+        return false;
+
+    const uint8_t* end = input + inputSize;
+    uint32_t state = 0;
+    for (int i = 0; i < 4; ++i)
+    {
+        state = (state << 8) | *input++;
+    }
+    for (size_t i = 0; i < symbolCount; ++i)
+    {
+        const uint32_t slot = state & (SCALE - 1);
+        const uint8_t symbol = symbolOfSlot[slot];
+        symbols[i] = symbol;
+        state = frequencies[symbol] * (state >> SCALE_BITS) + slot - starts[symbol];
+        while (state < LOWER_BOUND)
+        {
+            if (input == end)
+                return false;
+            state = (state << 8) | *input++;
+        }
+    }
+    return true;
+}
@@ -0,0 +1,303 @@
+#pragma once
+#include <glm/glm.hpp>
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstdint>
+#include <functional>
+#include <limits>
+#include <numeric>
+#include <random>
+#include <thread>
+#include <vector>
+
+// Blue noise hair roots on the triangles of a mesh. Candidate points are thrown with a probability proportional to
+// triangle area times a density mask, then thinned by a Poisson disk test so no two roots are closer than a radius
+// picked for the requested count. The test runs on a sparse grid with cells as wide as the radius, so only the roots
+// of the 26 neighbouring cells can be too close. The cells are processed in 8 phases by their coordinates modulo 2,
+// cells of a phase are at least a radius apart and don't share neighbours they write to, so each phase is split
+// between threads without locking, as in Wei's parallel Poisson disk sampling. The result only depends on the seed,
+// not on the thread count.
+class ScalpSampler {
+public:
+	using DensityMask = std::function<float(const glm::vec3&)>;		// In [0, 1], has to be safe to call from several threads
+
+	static constexpr uint32_t CANDIDATES_PER_ROOT = 4;
+	static constexpr uint32_t CANDIDATE_BLOCK_SIZE = 4096;		// Candidates generated from one seed, independent of the threads
+	static constexpr uint32_t RADIUS_ITERATIONS = 4;			// Attempts with a shrinking radius when too few candidates survive
+	static constexpr float PACKING_DENSITY = 0.46f;				// Roots times radius squared over the area for the first radius
+
+	ScalpSampler(const std::vector<glm::vec3>& positions, const std::vector<uint32_t>& indices, const DensityMask& _densityMask);
+
+	// Returns count roots, fewer only when the masked area can't hold them. The roots are in random order, so any
+	// prefix of them is spread over the whole scalp
+	std::vector<glm::vec3> sample(uint32_t count, uint32_t seed = 1U, uint32_t threadCount = 0);
+
+	// Area of the triangles weighted by their largest density
+	double getArea() const { return cumulativeWeights.empty() ? 0.0 : cumulativeWeights.back(); }
+	// Minimum distance between the roots of the last sample
+	float getRadius() const { return radius; }
+
+private:
+	struct Triangle {
+		glm::vec3 origin;
+		glm::vec3 edges[2];
+		float maxDensity;			// Upper bound of the mask on the triangle, candidates are rejected below it
+	};
+
+	struct GridEntry {
+		uint64_t cell;				// Packed cell coordinates, 21 bits each
+		uint32_t candidate;
+		uint32_t phase;
+		glm::vec3 position;			// Copied from the candidate, the neighbour scans stay in the sorted entries
+		uint32_t kept;
+
+		bool operator<(const GridEntry& other) const {
+            if (phase != other.phase)
+                return phase < other.phase;
+            if (cell != other.cell)
+                return cell < other.cell;
+            return candidate < other.candidate;
+        }
+	};
+
+	static constexpr uint32_t CELL_BITS = 21;
+	static constexpr uint32_t PHASE_COUNT = 8;
+	static constexpr uint32_t NO_CELL = std::numeric_limits<uint32_t>::max();
+	static constexpr uint64_t EMPTY_SLOT = std::numeric_limits<uint64_t>::max();
+
+	struct TableSlot {
+		uint64_t cell = EMPTY_SLOT;
+		uint32_t index = NO_CELL;
+	};
+
+	// Calls function(begin, end) on contiguous ranges of [0, count) from threadCount threads
+	static void parallelFor(uint32_t count, uint32_t threadCount, const std::function<void(uint32_t, uint32_t)>& function) {
+        threadCount = std::max(1U, std::min(threadCount, count));
+        std::vector<std::thread> workers;
+        for (uint32_t i = 1; i < threadCount; ++i)
+        {
+            workers.emplace_back(function, static_cast<uint32_t>(static_cast<uint64_t>(count) * i / threadCount),
+                static_cast<uint32_t>(static_cast<uint64_t>(count) * (i + 1) / threadCount));
+        }
+        function(0, static_cast<uint32_t>(count / threadCount));
+        for (auto& worker : workers)
+        {
+            worker.join();
+        }
+    }
+	static uint64_t packCell(const glm::ivec3& cell) {
+        return (static_cast<uint64_t>(cell.x) << (2 * CELL_BITS)) | (static_cast<uint64_t>(cell.y) << CELL_BITS) | static_cast<uint64_t>(cell.z);
+    }
+	static uint32_t getPhase(const glm::ivec3& cell) { return (cell.x & 1) | ((cell.y & 1) << 1) | ((cell.z & 1) << 2); }
+
+	std::vector<glm::vec3> generateCandidates(uint32_t count, uint32_t seed, uint32_t threadCount) const;
+	// Keeps the candidates that pass the disk test, returns their indices in cell order
+	std::vector<uint32_t> thin(const std::vector<glm::vec3>& candidates, float diskRadius, uint32_t threadCount) const;
+
+	DensityMask densityMask;
+	std::vector<Triangle> triangles;
+	std::vector<double> cumulativeWeights;		// Running sum of area times maximum density, for picking triangles
+	glm::vec3 boundsMin = glm::vec3(std::numeric_limits<float>::max());
+	glm::vec3 boundsMax = glm::vec3(std::numeric_limits<float>::lowest());
+	float radius = 0.f;
+};
+
+inline ScalpSampler::ScalpSampler(const std::vector<glm::vec3>& positions, const std::vector<uint32_t>& indices, const DensityMask& _densityMask)
+: densityMask(_densityMask)
+{
+    double totalWeight = 0.0;
+    for (size_t i = 0; i + 2 < indices.size(); i += 3)
+    {
+        const glm::vec3& a = positions[indices[i]];
+        const glm::vec3& b = positions[indices[i + 1]];
+        const glm::vec3& c = positions[indices[i + 2]];
+        const float area = 0.5f * glm::length(glm::cross(b - a, c - a));
+        const float maxDensity = std::max({ densityMask(a), densityMask(b), densityMask(c), densityMask((a + b + c) / 3.f) });
+        if (area <= 0.f || maxDensity <= 0.f)
+            continue;
+
+        triangles.push_back({ a, { b - a, c - a }, std::min(maxDensity, 1.f) });
+        totalWeight += static_cast<double>(area) * triangles.back().maxDensity;
+        cumulativeWeights.push_back(totalWeight);
+        boundsMin = glm::min(boundsMin, glm::min(a, glm::min(b, c)));
+        boundsMax = glm::max(boundsMax, glm::max(a, glm::max(b, c)));
+    }
+}
+
+inline std::vector<glm::vec3> ScalpSampler::sample(uint32_t count, uint32_t seed, uint32_t threadCount)
+{
+    if (triangles.empty() || count == 0)
+        return {};
+    if (threadCount == 0)
+        threadCount = std::max(1U, std::thread::hardware_concurrency());
+
+    const std::vector<glm::vec3> candidates = generateCandidates(count * CANDIDATES_PER_ROOT, seed, threadCount);
+    // Cells have to fit in 21 bits per axis
+    const float minimumRadius = glm::length(boundsMax - boundsMin) / ((1U << CELL_BITS) - 4);
+    radius = std::max(std::sqrt(static_cast<float>(PACKING_DENSITY * getArea() / count)), minimumRadius);
+    std::vector<uint32_t> kept;
+    for (uint32_t iteration = 0; iteration < RADIUS_ITERATIONS; ++iteration)
+    {
+        kept = thin(candidates, radius, threadCount);
+        if (kept.size() >= count || radius <= minimumRadius)
+            break;
+        // Surviving roots scale with the inverse squared radius, aim a little below the count
+        radius = std::max(radius * 0.97f * std::sqrt(static_cast<float>(kept.size()) / count), minimumRadius);
+    }
+
+    // The kept roots are in cell order, a shuffled prefix keeps the coverage even
+    std::mt19937 generator(seed);
+    std::shuffle(kept.begin(), kept.end(), generator);
+    kept.resize(std::min<size_t>(kept.size(), count));
+    std::vector<glm::vec3> roots(kept.size());
+    for (size_t i = 0; i < kept.size(); ++i)
+    {
+        roots[i] = candidates[kept[i]];
+    }
+    return roots;
+}
+
+inline std::vector<glm::vec3> ScalpSampler::generateCandidates(uint32_t count, uint32_t seed, uint32_t threadCount) const
+{
+    // Candidates the mask rejected too often stay NaN and are dropped
+    std::vector<glm::vec3> candidates(count, glm::vec3(std::numeric_limits<float>::quiet_NaN()));
+    const uint32_t blockCount = (count + CANDIDATE_BLOCK_SIZE - 1) / CANDIDATE_BLOCK_SIZE;
+    parallelFor(blockCount, threadCount, [&](uint32_t firstBlock, uint32_t lastBlock) {
+        for (uint32_t block = firstBlock; block < lastBlock; ++block)
+        {
+            std::mt19937 generator(seed * 0x9E3779B9U + block);
+            std::uniform_real_distribution<double> weightDistribution(0.0, cumulativeWeights.back());
+            std::uniform_real_distribution<float> unitDistribution(0.f, 1.f);
+            const uint32_t end = std::min(count, (block + 1) * CANDIDATE_BLOCK_SIZE);
+            for (uint32_t i = block * CANDIDATE_BLOCK_SIZE; i < end; ++i)
+            {
+                for (uint32_t attempt = 0; attempt < 32; ++attempt)
+                {
+                    const size_t triangleIndex = std::min<size_t>(triangles.size() - 1,
+                        std::upper_bound(cumulativeWeights.begin(), cumulativeWeights.end(), weightDistribution(generator)) - cumulativeWeights.begin());
+                    const Triangle& triangle = triangles[triangleIndex];
+                    // Uniform point in the triangle, the square root keeps the density constant towards the corners
+                    const float u = std::sqrt(unitDistribution(generator));
+                    const float v = unitDistribution(generator);
+                    const glm::vec3 position = triangle.origin + u * (1.f - v) * triangle.edges[0] + u * v * triangle.edges[1];
+                    if (unitDistribution(generator) * triangle.maxDensity < densityMask(position))
+                    {
+                        candidates[i] = position;
+                        break;
+                    }
+                }
+            }
+        }
+    });
+    candidates.erase(std::remove_if(candidates.begin(), candidates.end(), [](const glm::vec3& candidate) { return std::isnan(candidate.x); }),
+        candidates.end());
+    return candidates;
+}
+
+inline std::vector<uint32_t> ScalpSampler::thin(const std::vector<glm::vec3>& candidates, float diskRadius, uint32_t threadCount) const
+{
+    // One cell of margin, so the neighbours of every candidate have non-negative coordinates
+    const glm::vec3 origin = boundsMin - diskRadius;
+    const auto getCell = [&](const glm::vec3& position) { return glm::ivec3((position - origin) / diskRadius); };
+
+    std::vector<GridEntry> entries(candidates.size());
+    parallelFor(static_cast<uint32_t>(candidates.size()), threadCount, [&](uint32_t begin, uint32_t end) {
+        for (uint32_t i = begin; i < end; ++i)
+        {
+            const glm::ivec3 cell = getCell(candidates[i]);
+            entries[i] = { packCell(cell), i, getPhase(cell), candidates[i], 0 };
+        }
+    });
+    std::sort(entries.begin(), entries.end());
+
+    // Occupied cells, with the range of their candidates and the phase boundaries
+    std::vector<uint32_t> cellFirsts;
+    std::array<uint32_t, PHASE_COUNT + 1> phaseFirsts{};
+    for (uint32_t i = 0; i < entries.size(); ++i)
+    {
+        if (i == 0 || entries[i].cell != entries[i - 1].cell)
+            cellFirsts.push_back(i);
+    }
+    const uint32_t cellCount = static_cast<uint32_t>(cellFirsts.size());
+    cellFirsts.push_back(static_cast<uint32_t>(entries.size()));
+    for (uint32_t phase = 0, cell = 0; phase <= PHASE_COUNT; ++phase)
+    {
+        while (cell < cellCount && entries[cellFirsts[cell]].phase < phase)
+            ++cell;
+        phaseFirsts[phase] = cell;
+    }
+
+    // Open addressing table from the packed cell to its index, at most half full
+    uint32_t tableBits = 1;
+    while ((1U << tableBits) < 2 * std::max(cellCount, 1U))
+        ++tableBits;
+    const uint32_t tableMask = (1U << tableBits) - 1;
+    const auto getSlot = [tableBits](uint64_t cell) { return static_cast<uint32_t>((cell * 0x9E3779B97F4A7C15ULL) >> (64 - tableBits)); };
+    std::vector<TableSlot> table(tableMask + 1);
+    for (uint32_t cell = 0; cell < cellCount; ++cell)
+    {
+        uint32_t slot = getSlot(entries[cellFirsts[cell]].cell);
+        while (table[slot].cell != EMPTY_SLOT)
+            slot = (slot + 1) & tableMask;
+        table[slot] = { entries[cellFirsts[cell]].cell, cell };
+    }
+    const auto findCell = [&](uint64_t cell) {
+        for (uint32_t slot = getSlot(cell); table[slot].cell != EMPTY_SLOT; slot = (slot + 1) & tableMask)
+        {
+            if (table[slot].cell == cell)
+                return table[slot].index;
+        }
+        return NO_CELL;
+    };
+
+    // Phases run one after the other. A cell only writes its own candidates and reads the cells next to it, which
+    // belong to other phases, so the threads of a phase never touch the same cell
+    const float squaredRadius = diskRadius * diskRadius;
+    for (uint32_t phase = 0; phase < PHASE_COUNT; ++phase)
+    {
+        const uint32_t phaseFirst = phaseFirsts[phase];
+        parallelFor(phaseFirsts[phase + 1] - phaseFirst, threadCount, [&](uint32_t begin, uint32_t end) {
+            std::vector<glm::vec3> roots;			// Kept candidates around the cell, then in it
+            for (uint32_t cell = phaseFirst + begin; cell < phaseFirst + end; ++cell)
+            {
+                const glm::ivec3 coordinates = getCell(entries[cellFirsts[cell]].position);
+                roots.clear();
+                for (int z = -1; z <= 1; ++z)
+                    for (int y = -1; y <= 1; ++y)
+                        for (int x = -1; x <= 1; ++x)
+                        {
+                            const uint32_t neighbour = (x == 0 && y == 0 && z == 0) ? NO_CELL : findCell(packCell(coordinates + glm::ivec3(x, y, z)));
+                            if (neighbour == NO_CELL)
+                                continue;
+                            for (uint32_t i = cellFirsts[neighbour]; i < cellFirsts[neighbour + 1]; ++i)
+                            {
+                                if (entries[i].kept)
+                                    roots.push_back(entries[i].position);
+                            }
+                        }
+                for (uint32_t i = cellFirsts[cell]; i < cellFirsts[cell + 1]; ++i)
+                {
+                    const glm::vec3& position = entries[i].position;
+                    const bool isFree = std::none_of(roots.begin(), roots.end(), [&](const glm::vec3& root) {
+                        const glm::vec3 difference = root - position;
+                        return glm::dot(difference, difference) < squaredRadius;
+                    });
+                    if (isFree)
+                    {
+                        entries[i].kept = 1;
+                        roots.push_back(position);
+                    }
+                }
+            }
+        });
+    }
+
+    std::vector<uint32_t> result;
+    for (const GridEntry& entry : entries)
+    {
+        if (entry.kept)
+            result.push_back(entry.candidate);
+    }
+    return result;
+}
@@ -6,7 +6,10 @@
 #include <iostream>
 #include <fstream>
 #include <sstream>
+#include <vector>
 #include "PathConfig.h"
+#include "ProgramCache.h"
+#include <chrono>
 
 class Shader {
 public:
@@ -63,10 +66,53 @@ protected:
         return location;
     }
 
-	void linkProgram() const {
-        if (!programID)
-            std::cout << "Error: No shaders attached!" << std::endl;
+	struct Stage {
+		GLenum type;
+		std::string fileName;
+	};
 
+	// Loads the program from the binary cache when the sources, the defines and the driver are unchanged, and
+	// compiles, links and caches it otherwise
+	void buildProgram(const std::vector<Stage>& stages, const std::vector<std::string>& defines = {}) {
+        const auto start = std::chrono::steady_clock::now();
+        std::vector<std::string> sources;
+        uint64_t programHash = MeshCache::HASH_SEED;
+        for (const Stage& stage : stages)
+        {
+            sources.push_back(readSource(stage.fileName, defines));
+            programHash = MeshCache::hash(&stage.type, sizeof(stage.type), programHash);
+            programHash = MeshCache::hash(sources.back().data(), sources.back().size(), programHash);
+        }
+
+        programID = glCreateProgram();
+        const bool loaded = ProgramCache::load(programID, programHash);
+        if (!loaded)
+        {
+            // A rejected binary may leave the program unusable, the compiled one starts from a fresh object
+            glDeleteProgram(programID);
+            programID = glCreateProgram();
+            std::vector<GLuint> shaderIDs;
+            for (size_t i = 0; i < stages.size(); ++i)
+            {
+                shaderIDs.push_back(glCreateShader(stages[i].type));
+                compileAndAttachShader(stages[i].fileName, sources[i], shaderIDs.back());
+            }
+            if (ProgramCache::isAvailable())
+                glProgramParameteri(programID, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+            const bool linked = linkProgram();
+            for (GLuint shaderID : shaderIDs)
+            {
+                glDetachShader(programID, shaderID);
+                glDeleteShader(shaderID);
+            }
+            if (linked)
+                ProgramCache::store(programID, programHash);
+        }
+        ProgramCache::recordBuild(loaded, std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count());
+    }
+
+private:
+	bool linkProgram() const {
         GLint success;
         char infoLog[512];
 
@@ -76,11 +122,39 @@ protected:
             glGetProgramInfoLog(programID, 512, nullptr, infoLog);
             std::cout << "Failed to link program: " << infoLog << std::endl;
         }
+        return success;
     }
-	void compileAndAttachShader(const std::string& shaderFileName, GLuint& shaderID) {
-        std::string shaderCode;
-        std::ifstream shaderFile;
+	// Every line #include "<file>" is replaced by that file from the shader folder, and every define is inserted as
+	// "#define <define>" right after the #version line of the source
+	static std::string readSource(const std::string& shaderFileName, const std::vector<std::string>& defines) {
+        std::string shaderCode = readFile(shaderFileName);
 
+        const std::string includeDirective = "#include \"";
+        for (size_t includeBegin = shaderCode.find(includeDirective); includeBegin != std::string::npos;
+            includeBegin = shaderCode.find(includeDirective, includeBegin))
+        {
+            const size_t nameBegin = includeBegin + includeDirective.size();
+            const size_t nameEnd = shaderCode.find('"', nameBegin);
+            if (nameEnd == std::string::npos)
+                break;
+            shaderCode.replace(includeBegin, nameEnd + 1 - includeBegin, readFile(shaderCode.substr(nameBegin, nameEnd - nameBegin)));
+        }
+
+        if (!defines.empty())
+        {
+            std::string defineLines;
+            for (const auto& define : defines)
+            {
+                defineLines += "#define " + define + "\n";
+            }
+
+            const size_t versionLineEnd = shaderCode.find('\n');
+            shaderCode.insert(versionLineEnd == std::string::npos ? shaderCode.size() : versionLineEnd + 1, defineLines);
+        }
+        return shaderCode;
+    }
+	static std::string readFile(const std::string& shaderFileName) {
+        std::ifstream shaderFile;
         shaderFile.exceptions(std::ifstream::failbit | std::ifstream::badbit);
 
         try {
@@ -88,13 +162,15 @@ protected:
             std::stringstream ShaderStream;
 
             ShaderStream << shaderFile.rdbuf();
-            shaderCode = ShaderStream.str();
+            return ShaderStream.str();
         }
         catch (std::ifstream::failure& e) {
             std::cout << e.what() << std::endl;
-            std::cout << "Error: File not successfully read/found!" << std::endl;
+            std::cout << "Error: File " << shaderFileName << " not successfully read/found!" << std::endl;
         }
-
+        return "";
+    }
+	void compileAndAttachShader(const std::string& shaderFileName, const std::string& shaderCode, GLuint shaderID) const {
         GLint success;
         char infoLog[512];
         const char* shaderCodeString = shaderCode.c_str();
@@ -107,9 +183,6 @@ protected:
             std::cout << "Failed to compile  shader: " << shaderFileName << " " << infoLog << std::endl;
         }
 
-        if (!programID)
-            programID = glCreateProgram();
-
         glAttachShader(programID, shaderID);
     }
 };
\ No newline at end of file
@@ -0,0 +1,34 @@
+// Storage of COMPACT_POSITIONS, included by every shader that reads the strands. A strand is its root in model space
+// and the octahedral direction of each segment packed as two snorm16, see CompactPositions.h. Shaders that write the
+// directions define WRITE_DIRECTIONS before the include.
+
+#ifdef WRITE_DIRECTIONS
+layout (std430, binding = 0) buffer HairDirection {
+#else
+layout (std430, binding = 0) readonly buffer HairDirection {
+#endif
+	uint directions[];		// Direction of the segment ending at every particle, unused for the roots
+};
+
+// Rest length of every strand's segments
+layout (std430, binding = 19) readonly buffer SegmentLengths {
+	float segmentLengths[];
+};
+
+layout (std430, binding = 20) readonly buffer HairRoot {
+	float roots[][3];
+};
+
+vec3 decodeDirection(in uint encoded)
+{
+	const vec2 octahedron = unpackSnorm2x16(encoded);
+	vec3 direction = vec3(octahedron, 1.0 - abs(octahedron.x) - abs(octahedron.y));
+	const float fold = max(-direction.z, 0.0);
+	direction.xy += mix(vec2(fold), vec2(-fold), greaterThanEqual(direction.xy, vec2(0.0)));
+	return normalize(direction);
+}
+
+vec3 loadRoot(in uint strand)
+{
+	return vec3(roots[strand][0], roots[strand][1], roots[strand][2]);
+}
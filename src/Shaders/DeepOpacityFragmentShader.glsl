@@ -0,0 +1,25 @@
+#version 460 core
+
+#ifdef DEPTH_PASS
+// Only the depth of the first strand is needed
+void main()
+{
+}
+#else
+out vec4 opacity;
+
+uniform sampler2D opacityDepth;
+uniform float lightDepthRange;
+uniform vec4 opacityLayerEnds;
+uniform float strandOpacity;
+
+void main()
+{
+	// Orthographic light projection, so window depth is linear in the distance from the light
+	const float firstDepth = texelFetch(opacityDepth, ivec2(gl_FragCoord.xy), 0).r;
+	const float depthBehindFirst = max(gl_FragCoord.z - firstDepth, 0.0) * lightDepthRange;
+
+	// Every layer ending behind this strand sees its opacity, so the channels are cumulative
+	opacity = strandOpacity * vec4(lessThan(vec4(depthBehindFirst), opacityLayerEnds));
+}
+#endif
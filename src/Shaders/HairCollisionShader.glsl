@@ -0,0 +1,326 @@
+#version 460 core
+#define COUNT_CELLS 0
+#define SCAN_BLOCKS 1
+#define SCAN_BLOCK_SUMS 2
+#define ADD_BLOCK_OFFSETS 3
+#define SCATTER 4
+#define REPULSE 5
+#define DECODE_POSITIONS 6
+
+#define GROUP_SIZE 512
+#define SCAN_BLOCK_SIZE (2 * GROUP_SIZE)
+
+layout (local_size_x = GROUP_SIZE) in;
+
+#ifdef COMPACT_POSITIONS
+#include "CompactPositions.glsl"
+
+// World space positions of the particles, decoded once per step so every lookup of the other passes is a single read
+layout (std430, binding = 21) buffer DecodedPosition {
+	float decodedPositions[][3];
+};
+#else
+layout (std430, binding = 0) readonly buffer HairPosition {
+	float positions[][3];
+};
+#endif
+
+#if defined(COMPACT_POSITIONS) && defined(BATCHED)
+#error "Compact positions are not supported in batched mode"
+#endif
+
+#ifdef HALF_VELOCITIES
+layout (std430, binding = 1) buffer HairVelocity {
+	uint velocities[][2];
+};
+#else
+layout (std430, binding = 1) buffer HairVelocity {
+	float velocities[][3];
+};
+#endif
+
+layout (std430, binding = 4) buffer CellCount {
+	uint cellCounts[];
+};
+
+layout (std430, binding = 5) buffer CellStart {
+	uint cellStarts[];
+};
+
+// x - hashed cell of the particle, y - slot of the particle inside of that cell
+layout (std430, binding = 6) buffer ParticleCell {
+	uvec2 particleCells[];
+};
+
+layout (std430, binding = 7) buffer SortedParticle {
+	uint sortedParticles[];
+};
+
+layout (std430, binding = 8) buffer BlockSum {
+	uint blockSums[];
+};
+
+#ifdef BATCHED
+#include "HairInstance.glsl"
+#endif
+
+uniform uint state;
+uniform mat4 model;
+uniform uint particleCount;
+uniform uint particlesPerStrand;
+uniform uint hashTableSize;
+uniform float cellSize;
+uniform float collisionRadius;
+uniform float repulsionStiffness;
+uniform float deltaTime;
+
+shared uint scanData[SCAN_BLOCK_SIZE];
+
+#ifdef COMPACT_POSITIONS
+void storeDecodedPosition(in uint particle, in vec3 position)
+{
+	decodedPositions[particle][0] = position.x;
+	decodedPositions[particle][1] = position.y;
+	decodedPositions[particle][2] = position.z;
+}
+
+// One invocation per strand walks it from the root
+void decodePositions()
+{
+	const uint strand = gl_GlobalInvocationID.x;
+	if (strand >= particleCount / particlesPerStrand)
+		return;
+
+	const uint offset = strand * particlesPerStrand;
+	vec3 position = vec3(model * vec4(loadRoot(strand), 1.f));
+	storeDecodedPosition(offset, position);
+	for (uint i = 1; i < particlesPerStrand; ++i)
+	{
+		position += segmentLengths[strand] * decodeDirection(directions[offset + i]);
+		storeDecodedPosition(offset + i, position);
+	}
+}
+#endif
+
+vec3 loadParticlePosition(in uint particle)
+{
+#ifdef COMPACT_POSITIONS
+	return vec3(decodedPositions[particle][0], decodedPositions[particle][1], decodedPositions[particle][2]);
+#else
+	const vec3 position = vec3(positions[particle][0], positions[particle][1], positions[particle][2]);
+
+	// Roots are stored in model space, the rest of the strand is already in world space
+	if (particle % particlesPerStrand == 0)
+	{
+#ifdef BATCHED
+		return vec3(instances[strandInstances[particle / particlesPerStrand]].model * vec4(position, 1.f));
+#else
+		return vec3(model * vec4(position, 1.f));
+#endif
+	}
+
+	return position;
+#endif
+}
+
+ivec3 cellCoords(in vec3 position)
+{
+	return ivec3(floor(position / cellSize));
+}
+
+// Teschner et al., Optimized Spatial Hashing for Collision Detection of Deformable Objects
+uint hashCell(in ivec3 cell)
+{
+	return (uint(cell.x * 73856093) ^ uint(cell.y * 19349663) ^ uint(cell.z * 83492791)) % hashTableSize;
+}
+
+void countCells()
+{
+	if (gl_GlobalInvocationID.x >= particleCount)
+		return;
+
+	const uint cell = hashCell(cellCoords(loadParticlePosition(gl_GlobalInvocationID.x)));
+	particleCells[gl_GlobalInvocationID.x] = uvec2(cell, atomicAdd(cellCounts[cell], 1));
+}
+
+// Work-efficient exclusive scan (Blelloch) of SCAN_BLOCK_SIZE elements per work group
+uint scanSharedData(in uint elementCount)
+{
+	const uint thread = gl_LocalInvocationID.x;
+	uint offset = 1;
+
+	for (uint d = elementCount >> 1; d > 0; d >>= 1)
+	{
+		barrier();
+		if (thread < d)
+		{
+			const uint ai = offset * (2 * thread + 1) - 1;
+			const uint bi = offset * (2 * thread + 2) - 1;
+			scanData[bi] += scanData[ai];
+		}
+		offset *= 2;
+	}
+
+	barrier();
+	const uint total = scanData[elementCount - 1];
+	barrier();
+	if (thread == 0)
+		scanData[elementCount - 1] = 0;
+
+	for (uint d = 1; d < elementCount; d *= 2)
+	{
+		offset >>= 1;
+		barrier();
+		if (thread < d)
+		{
+			const uint ai = offset * (2 * thread + 1) - 1;
+			const uint bi = offset * (2 * thread + 2) - 1;
+			const uint t = scanData[ai];
+			scanData[ai] = scanData[bi];
+			scanData[bi] += t;
+		}
+	}
+
+	barrier();
+	return total;
+}
+
+void scanBlocks()
+{
+	const uint thread = gl_LocalInvocationID.x;
+	const uint blockOffset = gl_WorkGroupID.x * SCAN_BLOCK_SIZE;
+
+	scanData[2 * thread] = cellCounts[blockOffset + 2 * thread];
+	scanData[2 * thread + 1] = cellCounts[blockOffset + 2 * thread + 1];
+
+	const uint total = scanSharedData(SCAN_BLOCK_SIZE);
+
+	cellStarts[blockOffset + 2 * thread] = scanData[2 * thread];
+	cellStarts[blockOffset + 2 * thread + 1] = scanData[2 * thread + 1];
+	if (thread == 0)
+		blockSums[gl_WorkGroupID.x] = total;
+}
+
+void scanBlockSums()
+{
+	const uint thread = gl_LocalInvocationID.x;
+	const uint blockCount = hashTableSize / SCAN_BLOCK_SIZE;
+
+	scanData[2 * thread] = 2 * thread < blockCount ? blockSums[2 * thread] : 0;
+	scanData[2 * thread + 1] = 2 * thread + 1 < blockCount ? blockSums[2 * thread + 1] : 0;
+
+	scanSharedData(SCAN_BLOCK_SIZE);
+
+	if (2 * thread < blockCount) blockSums[2 * thread] = scanData[2 * thread];
+	if (2 * thread + 1 < blockCount) blockSums[2 * thread + 1] = scanData[2 * thread + 1];
+}
+
+void addBlockOffsets()
+{
+	if (gl_GlobalInvocationID.x >= hashTableSize)
+		return;
+
+	cellStarts[gl_GlobalInvocationID.x] += blockSums[gl_GlobalInvocationID.x / SCAN_BLOCK_SIZE];
+}
+
+void scatterParticles()
+{
+	if (gl_GlobalInvocationID.x >= particleCount)
+		return;
+
+	const uvec2 cell = particleCells[gl_GlobalInvocationID.x];
+	sortedParticles[cellStarts[cell.x] + cell.y] = gl_GlobalInvocationID.x;
+}
+
+void repulseParticles()
+{
+	const uint particle = gl_GlobalInvocationID.x;
+	if (particle >= particleCount || particle % particlesPerStrand == 0)
+		return;
+
+	const uint strand = particle / particlesPerStrand;
+	const vec3 particlePosition = loadParticlePosition(particle);
+	const ivec3 cell = cellCoords(particlePosition);
+	vec3 repulsion = vec3(0.0);
+
+	for (int i = -1; i <= 1; ++i)
+	{
+		for (int j = -1; j <= 1; ++j)
+		{
+			for (int k = -1; k <= 1; ++k)
+			{
+				const uint neighbourCell = hashCell(cell + ivec3(i, j, k));
+				const uint cellEnd = cellStarts[neighbourCell] + cellCounts[neighbourCell];
+				for (uint n = cellStarts[neighbourCell]; n < cellEnd; ++n)
+				{
+					const uint neighbour = sortedParticles[n];
+
+					// Neighbours on the same strand are kept apart by follow the leader already
+					if (neighbour / particlesPerStrand == strand)
+						continue;
+
+					const vec3 difference = particlePosition - loadParticlePosition(neighbour);
+					const float distance = length(difference);
+					if (distance < collisionRadius && distance > 0.0)
+						repulsion += (difference / distance) * (collisionRadius - distance);
+				}
+			}
+		}
+	}
+
+	if (repulsion == vec3(0.0))
+		return;
+
+	// Position penetration is turned into a velocity impulse, so follow the leader stays the only position constraint.
+	// Position Verlet stores displacements, so the impulse is applied to the displacement directly
+#ifdef VERLET_INTEGRATION
+	repulsion *= repulsionStiffness;
+#else
+	repulsion *= repulsionStiffness / deltaTime;
+#endif
+#ifdef HALF_VELOCITIES
+	const vec3 velocity = vec3(unpackHalf2x16(velocities[particle][0]), unpackHalf2x16(velocities[particle][1]).x) + repulsion;
+	velocities[particle][0] = packHalf2x16(velocity.xy);
+	velocities[particle][1] = packHalf2x16(vec2(velocity.z, 0.0));
+#else
+	velocities[particle][0] += repulsion.x;
+	velocities[particle][1] += repulsion.y;
+	velocities[particle][2] += repulsion.z;
+#endif
+}
+
+void main(void)
+{
+	switch (state)
+	{
+		case COUNT_CELLS:
+			countCells();
+			break;
+
+		case SCAN_BLOCKS:
+			scanBlocks();
+			break;
+
+		case SCAN_BLOCK_SUMS:
+			scanBlockSums();
+			break;
+
+		case ADD_BLOCK_OFFSETS:
+			addBlockOffsets();
+			break;
+
+		case SCATTER:
+			scatterParticles();
+			break;
+
+		case REPULSE:
+			repulseParticles();
+			break;
+
+#ifdef COMPACT_POSITIONS
+		case DECODE_POSITIONS:
+			decodePositions();
+			break;
+#endif
+	}
+}
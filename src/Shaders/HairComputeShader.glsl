@@ -3,20 +3,48 @@
 #define FTL 0
 #define FILL_VOLUMES 1
 #define COLLISIONS 2
+#define RESOLVE_VOLUMES 3
 
 #define ELLIPSOID_COUNT 7
 #define VOLUME_UPPER_LIMIT 10
 
 layout (local_size_x = 128) in;
 
+#ifdef COMPACT_POSITIONS
+#ifdef BATCHED
+#error "Compact positions are not supported in batched mode"
+#endif
+
+// The solver writes the directions back after moving the strands
+#define WRITE_DIRECTIONS
+#include "CompactPositions.glsl"
+#else
 layout (std430, binding = 0) buffer HairPosition {
 	float positions[][3];
 };
+#endif
 
+#ifdef HALF_VELOCITIES
+// x and y in the first word, z in the lower half of the second one
+layout (std430, binding = 1) buffer HairVelocity {
+	uint velocities[][2];
+};
+#else
 layout (std430, binding = 1) buffer HairVelocity {
 	float velocities[][3];
 };
+#endif
 
+#ifdef BATCHED
+// Every instance of the batch owns one friction grid, centered at the origin of its model matrix
+layout (std430, binding = 2) buffer volumeDensity {
+	int volumeDensities[][11][11][11];
+};
+
+layout (std430, binding = 3) buffer volumeVelocity {
+	int volumeVelocities[][11][11][11][3];
+};
+#else
 layout (std430, binding = 2) buffer volumeDensity {
 	int volumeDensities[11][11][11];
 };
@@ -24,6 +52,26 @@ layout (std430, binding = 2) buffer volumeDensity {
 layout (std430, binding = 3) buffer volumeVelocity {
 	int volumeVelocities[11][11][11][3];
 };
+#endif
+
+#ifdef HALF_VELOCITIES
+#ifdef BATCHED
+#error "Half precision velocities are not supported in batched mode"
+#endif
+
+// Grid velocities divided by density, resolved once after filling the volumes so the gather reads half the data
+layout (std430, binding = 12) buffer resolvedVolumeVelocity {
+	uint resolvedVolumeVelocities[11][11][11][2];
+};
+#endif
+
+// Rest length of every strand's segments, imported strands differ in length. Compact positions declare it with the rest
+// of their storage.
+#if defined(STRAND_SEGMENT_LENGTHS) && !defined(COMPACT_POSITIONS)
+layout (std430, binding = 19) readonly buffer SegmentLengths {
+	float segmentLengths[];
+};
+#endif
 
 struct HairData {
 	uint particlesPerStrand;
@@ -38,6 +86,43 @@ struct Force {
 };
 
 
+#ifdef BATCHED
+#include "HairInstance.glsl"
+
+// Collider transform followed by its inverse
+layout (std430, binding = 11) readonly buffer Colliders {
+	mat4 colliders[];
+};
+
+uint instanceIndex = 0;
+
+#define MODEL instances[instanceIndex].model
+#define WIND instances[instanceIndex].wind
+#define GRAVITY instances[instanceIndex].gravity
+#define FRICTION_COEFFICIENT instances[instanceIndex].frictionCoefficient
+#define VELOCITY_DAMPING_COEFFICIENT instances[instanceIndex].velocityDampingCoefficient
+#define VOLUME_DENSITIES volumeDensities[instanceIndex]
+#define VOLUME_VELOCITIES volumeVelocities[instanceIndex]
+#define VOLUME_CENTER vec3(instances[instanceIndex].model[3])
+#define SELECT_INSTANCE(strand) instanceIndex = strandInstances[strand]
+#else
+#define MODEL model
+#define WIND force.wind
+#define GRAVITY force.gravity
+#define FRICTION_COEFFICIENT frictionCoefficient
+#define VELOCITY_DAMPING_COEFFICIENT velocityDampingCoefficient
+#define VOLUME_DENSITIES volumeDensities
+#define VOLUME_VELOCITIES volumeVelocities
+#define VOLUME_CENTER vec3(0.0)
+#define SELECT_INSTANCE(strand)
+#endif
+
+#ifdef STRAND_SEGMENT_LENGTHS
+#define STRAND_SEGMENT_LENGTH(strand) segmentLengths[strand]
+#else
+#define STRAND_SEGMENT_LENGTH(strand) hairData.segmentLength
+#endif
+
 uniform mat4 ellipsoids[ELLIPSOID_COUNT];
 uniform float ellipsoidRadius;
 uniform mat4 model;
@@ -46,36 +131,89 @@ uniform Force force;
 uniform HairData hairData;
 uniform float deltaTime;
 uniform float runningTime;
+uniform float lastDeltaTime;
+uniform sampler3D windField;
+uniform vec3 windFieldMin;
+uniform float windFieldSize;
 uniform float velocityDampingCoefficient = 0.90;
 uniform float frictionCoefficient = 0.0;
 
-vec3 followTheLeader(in vec3 leaderParticlePosition, in vec3 proposedParticlePosition, out vec3 positionCorrectionVector) 
+#ifdef COMPACT_POSITIONS
+uint encodeDirection(in vec3 direction)
+{
+	direction /= max(abs(direction.x) + abs(direction.y) + abs(direction.z), 1e-20);
+	vec2 octahedron = direction.xy;
+	// The lower hemisphere is folded over the diagonals of the octahedron
+	if (direction.z < 0.0)
+		octahedron = (1.0 - abs(direction.yx)) * mix(vec2(-1.0), vec2(1.0), greaterThanEqual(direction.xy, vec2(0.0)));
+	return packSnorm2x16(octahedron);
+}
+#endif
+
+vec3 loadVelocity(in uint particle)
+{
+#ifdef HALF_VELOCITIES
+	return vec3(unpackHalf2x16(velocities[particle][0]), unpackHalf2x16(velocities[particle][1]).x);
+#else
+	return vec3(velocities[particle][0], velocities[particle][1], velocities[particle][2]);
+#endif
+}
+
+void storeVelocity(in uint particle, in vec3 velocity)
+{
+#ifdef HALF_VELOCITIES
+	velocities[particle][0] = packHalf2x16(velocity.xy);
+	velocities[particle][1] = packHalf2x16(vec2(velocity.z, 0.0));
+#else
+	velocities[particle][0] = velocity.x;
+	velocities[particle][1] = velocity.y;
+	velocities[particle][2] = velocity.z;
+#endif
+}
+
+// Position Verlet keeps the displacement of the last step in the velocity buffer and derives velocity from it
+vec3 loadParticleVelocity(in uint particle)
+{
+#ifdef VERLET_INTEGRATION
+	return loadVelocity(particle) / deltaTime;
+#else
+	return loadVelocity(particle);
+#endif
+}
+
+void storeParticleVelocity(in uint particle, in vec3 velocity)
+{
+#ifdef VERLET_INTEGRATION
+	storeVelocity(particle, velocity * deltaTime);
+#else
+	storeVelocity(particle, velocity);
+#endif
+}
+
+vec3 followTheLeader(in vec3 leaderParticlePosition, in vec3 proposedParticlePosition, in float segmentLength, out vec3 positionCorrectionVector) 
 {
 	const vec3 direction = normalize(proposedParticlePosition - leaderParticlePosition);
-	vec3 fixedPosition = leaderParticlePosition + (direction * hairData.segmentLength);
+	vec3 fixedPosition = leaderParticlePosition + (direction * segmentLength);
 	positionCorrectionVector = fixedPosition - proposedParticlePosition;
 	return fixedPosition;
 }
 
 vec3 generateGravityForce() 
 {
-	return hairData.particleMass * vec3(0.0, force.gravity, 0.0);
+	return hairData.particleMass * vec3(0.0, GRAVITY, 0.0);
 }
 
 vec3 generateWindForce(in vec3 particlePosition) 
 {
-	if (vec3(force.wind) == vec3(0.0)) 
+	if (vec3(WIND) == vec3(0.0)) 
 	{
-		return force.wind.w * normalize(vec3(
-					sin(runningTime + particlePosition.z * 20.0),
-                    cos(deltaTime * particlePosition.y * 5.0),
-                    sin(runningTime + particlePosition.x * 30.0)
-
-			   ));
+		// Animated field generated once per frame, hardware trilinear filtering does the interpolation
+		const vec3 fieldCoords = (particlePosition - VOLUME_CENTER - windFieldMin) / windFieldSize;
+		return WIND.w * texture(windField, fieldCoords).xyz;
 	} 
 	else
 	{
-		return normalize(vec3(force.wind)) * force.wind.w;
+		return normalize(vec3(WIND)) * WIND.w;
 	}
 }
 
@@ -97,6 +235,13 @@ vec3 integrateHeun(in vec3 forces, in vec3 particlePosition, in vec3 particleVel
 	return (particlePosition + deltaTime * ((firstVelocity + secondVelocity) / 2));
 }
 
+// Previous position is particlePosition - particleDisplacement, rescaled for a changing time step
+vec3 integratePositionVerlet(in vec3 forces, in vec3 particlePosition, in vec3 particleDisplacement)
+{
+	const vec3 acceleration = forces / hairData.particleMass;
+	return particlePosition + particleDisplacement * (deltaTime / lastDeltaTime) + acceleration * deltaTime * deltaTime;
+}
+
 vec3 updateVelocity(in vec3 oldPosition, in vec3 newPosition) 
 {
 	return ((newPosition - oldPosition) / deltaTime);
@@ -105,7 +250,7 @@ vec3 updateVelocity(in vec3 oldPosition, in vec3 newPosition)
 // Very useful article: https://www.scratchapixel.com/lessons/mathematics-physics-for-computer-graphics/interpolation/introduction
 vec3 interpolateVelocity(in vec3 particlePosition)
 {
-	particlePosition += (VOLUME_UPPER_LIMIT / 2);
+	particlePosition += (VOLUME_UPPER_LIMIT / 2) - VOLUME_CENTER;
 	ivec3 flooredCoords = ivec3(floor(particlePosition));
 
 	// Upper limit of the regular voxel grid, flooring to 9
@@ -120,11 +265,16 @@ vec3 interpolateVelocity(in vec3 particlePosition)
 		{
 			for (uint k = 0; k < 2; ++k)
 			{
-				voxelVertexVelocities[i][j][k].x = volumeVelocities[flooredCoords.x + i][flooredCoords.y + j][flooredCoords.z + k][0];
-				voxelVertexVelocities[i][j][k].y = volumeVelocities[flooredCoords.x + i][flooredCoords.y + j][flooredCoords.z + k][1];
-				voxelVertexVelocities[i][j][k].z = volumeVelocities[flooredCoords.x + i][flooredCoords.y + j][flooredCoords.z + k][2];
-				if (volumeDensities[flooredCoords.x + i][flooredCoords.y + j][flooredCoords.z + k] != 0)
-					voxelVertexVelocities[i][j][k] /= float(volumeDensities[flooredCoords.x + i][flooredCoords.y + j][flooredCoords.z + k]);
+#ifdef HALF_VELOCITIES
+				const uvec2 packedVelocity = resolvedVolumeVelocities[flooredCoords.x + i][flooredCoords.y + j][flooredCoords.z + k];
+				voxelVertexVelocities[i][j][k] = vec3(unpackHalf2x16(packedVelocity.x), unpackHalf2x16(packedVelocity.y).x);
+#else
+				voxelVertexVelocities[i][j][k].x = VOLUME_VELOCITIES[flooredCoords.x + i][flooredCoords.y + j][flooredCoords.z + k][0];
+				voxelVertexVelocities[i][j][k].y = VOLUME_VELOCITIES[flooredCoords.x + i][flooredCoords.y + j][flooredCoords.z + k][1];
+				voxelVertexVelocities[i][j][k].z = VOLUME_VELOCITIES[flooredCoords.x + i][flooredCoords.y + j][flooredCoords.z + k][2];
+				if (VOLUME_DENSITIES[flooredCoords.x + i][flooredCoords.y + j][flooredCoords.z + k] != 0)
+					voxelVertexVelocities[i][j][k] /= float(VOLUME_DENSITIES[flooredCoords.x + i][flooredCoords.y + j][flooredCoords.z + k]);
+#endif
 			}
 		}
 	}
@@ -152,31 +302,48 @@ vec3 interpolateVelocity(in vec3 particlePosition)
 
 vec3 correctFtlVelocity(in vec3 currentParticleVelocity, in vec3 nextParticleCorrectionVector) 
 {
-	const vec3 correctedVelocity = currentParticleVelocity + velocityDampingCoefficient * (-nextParticleCorrectionVector / deltaTime);
+	const vec3 correctedVelocity = currentParticleVelocity + VELOCITY_DAMPING_COEFFICIENT * (-nextParticleCorrectionVector / deltaTime);
 	return correctedVelocity;
 }
 
+void addParticleFriction(in uint particle, in vec3 particlePosition)
+{
+	vec3 particleVelocity = loadParticleVelocity(particle);
+	particleVelocity = (1.0 - FRICTION_COEFFICIENT) * particleVelocity + FRICTION_COEFFICIENT * interpolateVelocity(particlePosition);
+	storeParticleVelocity(particle, particleVelocity);
+}
+
 void addHairFriction()
 {
-	if (gl_GlobalInvocationID.x > hairData.strandCount * hairData.particlesPerStrand)
+#ifdef COMPACT_POSITIONS
+	// One invocation per strand, every particle is decoded once on the walk from the root
+	const uint strand = gl_GlobalInvocationID.x;
+	if (strand >= hairData.strandCount)
 		return;
 
-	vec3 particlePosition = vec3(positions[gl_GlobalInvocationID.x][0], positions[gl_GlobalInvocationID.x][1], positions[gl_GlobalInvocationID.x][2]); 
-	vec3 particleVelocity = vec3(velocities[gl_GlobalInvocationID.x][0], velocities[gl_GlobalInvocationID.x][1], velocities[gl_GlobalInvocationID.x][2]); 
-	particleVelocity = (1.0 - frictionCoefficient) * particleVelocity + frictionCoefficient * interpolateVelocity(particlePosition);
-	velocities[gl_GlobalInvocationID.x][0] = particleVelocity.x;
-	velocities[gl_GlobalInvocationID.x][1] = particleVelocity.y;
-	velocities[gl_GlobalInvocationID.x][2] = particleVelocity.z;
+	const uint offset = strand * hairData.particlesPerStrand;
+	vec3 particlePosition = vec3(MODEL * vec4(loadRoot(strand), 1.f));
+	addParticleFriction(offset, particlePosition);
+	for (uint i = 1; i < hairData.particlesPerStrand; ++i)
+	{
+		particlePosition += STRAND_SEGMENT_LENGTH(strand) * decodeDirection(directions[offset + i]);
+		addParticleFriction(offset + i, particlePosition);
+	}
+#else
+	if (gl_GlobalInvocationID.x >= hairData.strandCount * hairData.particlesPerStrand)
+		return;
+
+	SELECT_INSTANCE(gl_GlobalInvocationID.x / hairData.particlesPerStrand);
+	const uint particle = gl_GlobalInvocationID.x;
+	addParticleFriction(particle, vec3(positions[particle][0], positions[particle][1], positions[particle][2]));
+#endif
 }
 
-void fillVolumes() 
+void fillParticleVolumes(in uint particle, in vec3 particlePosition)
 {
-	if (gl_GlobalInvocationID.x > hairData.strandCount * hairData.particlesPerStrand)
-		return;
-
 	// Adding 5 to linearly map [-5,5] range to [0,10] range
-	const vec3 particlePosition = vec3(positions[gl_GlobalInvocationID.x][0], positions[gl_GlobalInvocationID.x][1], positions[gl_GlobalInvocationID.x][2]) + (VOLUME_UPPER_LIMIT / 2); 
-	const vec3 particleVelocity = vec3(velocities[gl_GlobalInvocationID.x][0], velocities[gl_GlobalInvocationID.x][1], velocities[gl_GlobalInvocationID.x][2]); 
+	particlePosition += (VOLUME_UPPER_LIMIT / 2) - VOLUME_CENTER;
+	const vec3 particleVelocity = loadParticleVelocity(particle);
 	ivec3 flooredCoords = ivec3(floor(particlePosition));
 	if (flooredCoords.x >= VOLUME_UPPER_LIMIT) flooredCoords.x = VOLUME_UPPER_LIMIT - 1;
 	if (flooredCoords.y >= VOLUME_UPPER_LIMIT) flooredCoords.y = VOLUME_UPPER_LIMIT - 1;
@@ -190,17 +357,73 @@ void fillVolumes()
 			{
 				float densityW = (1.0 - abs(particlePosition.x - flooredCoords.x - i)) * (1.0 - abs(particlePosition.y - flooredCoords.y - j)) * (1.0 - abs(particlePosition.z - flooredCoords.z - k)) * 1000.f;
 				int densityWeight = int(densityW);
-				atomicAdd(volumeDensities[flooredCoords.x + i][flooredCoords.y + j][flooredCoords.z + k], densityWeight);
-				atomicAdd(volumeVelocities[flooredCoords.x + i][flooredCoords.y + j][flooredCoords.z + k][0], int(densityWeight * particleVelocity.x));
-				atomicAdd(volumeVelocities[flooredCoords.x + i][flooredCoords.y + j][flooredCoords.z + k][1], int(densityWeight * particleVelocity.y));
-				atomicAdd(volumeVelocities[flooredCoords.x + i][flooredCoords.y + j][flooredCoords.z + k][2], int(densityWeight * particleVelocity.z));
+				atomicAdd(VOLUME_DENSITIES[flooredCoords.x + i][flooredCoords.y + j][flooredCoords.z + k], densityWeight);
+				atomicAdd(VOLUME_VELOCITIES[flooredCoords.x + i][flooredCoords.y + j][flooredCoords.z + k][0], int(densityWeight * particleVelocity.x));
+				atomicAdd(VOLUME_VELOCITIES[flooredCoords.x + i][flooredCoords.y + j][flooredCoords.z + k][1], int(densityWeight * particleVelocity.y));
+				atomicAdd(VOLUME_VELOCITIES[flooredCoords.x + i][flooredCoords.y + j][flooredCoords.z + k][2], int(densityWeight * particleVelocity.z));
 			}
 		}
 	}
 }
 
+void fillVolumes()
+{
+#ifdef COMPACT_POSITIONS
+	// One invocation per strand, every particle is decoded once on the walk from the root
+	const uint strand = gl_GlobalInvocationID.x;
+	if (strand >= hairData.strandCount)
+		return;
+
+	const uint offset = strand * hairData.particlesPerStrand;
+	vec3 particlePosition = vec3(MODEL * vec4(loadRoot(strand), 1.f));
+	fillParticleVolumes(offset, particlePosition);
+	for (uint i = 1; i < hairData.particlesPerStrand; ++i)
+	{
+		particlePosition += STRAND_SEGMENT_LENGTH(strand) * decodeDirection(directions[offset + i]);
+		fillParticleVolumes(offset + i, particlePosition);
+	}
+#else
+	if (gl_GlobalInvocationID.x >= hairData.strandCount * hairData.particlesPerStrand)
+		return;
+
+	SELECT_INSTANCE(gl_GlobalInvocationID.x / hairData.particlesPerStrand);
+	const uint particle = gl_GlobalInvocationID.x;
+	fillParticleVolumes(particle, vec3(positions[particle][0], positions[particle][1], positions[particle][2]));
+#endif
+}
+
+#ifdef HALF_VELOCITIES
+void resolveVolumes()
+{
+	if (gl_GlobalInvocationID.x >= 11 * 11 * 11)
+		return;
+
+	const uint x = gl_GlobalInvocationID.x / (11 * 11);
+	const uint y = (gl_GlobalInvocationID.x / 11) % 11;
+	const uint z = gl_GlobalInvocationID.x % 11;
+
+	vec3 velocity = vec3(volumeVelocities[x][y][z][0], volumeVelocities[x][y][z][1], volumeVelocities[x][y][z][2]);
+	if (volumeDensities[x][y][z] != 0)
+		velocity /= float(volumeDensities[x][y][z]);
+
+	resolvedVolumeVelocities[x][y][z] = uvec2(packHalf2x16(velocity.xy), packHalf2x16(vec2(velocity.z, 0.0)));
+}
+#endif
+
 void resolveBodyCollision(inout vec3 particlePosition) 
 {
+#ifdef BATCHED
+	const uint colliderEnd = instances[instanceIndex].colliderOffset + instances[instanceIndex].colliderCount;
+	for (uint i = instances[instanceIndex].colliderOffset; i < colliderEnd; ++i)
+	{
+		vec3 transformedPosition = vec3(colliders[2 * i + 1] * vec4(particlePosition, 1.f));
+		if (length(transformedPosition) < ellipsoidRadius) 
+		{
+			transformedPosition = normalize(transformedPosition) * (ellipsoidRadius);
+			particlePosition = vec3(colliders[2 * i] * vec4(transformedPosition, 1.f));
+		}
+	}
+#else
 	for (uint i = 0; i < ELLIPSOID_COUNT; ++i)
 	{
 		vec3 transformedPosition = vec3(inverse(ellipsoids[i]) * vec4(particlePosition, 1.f));
@@ -210,18 +433,31 @@ void resolveBodyCollision(inout vec3 particlePosition)
 			particlePosition = vec3(ellipsoids[i] * vec4(transformedPosition, 1.f));
 		}
 	}
+#endif
 }
 
 void moveParticles()
 {
-	if (gl_GlobalInvocationID.x > hairData.strandCount)
+	if (gl_GlobalInvocationID.x >= hairData.strandCount)
 		return; 
 
+	SELECT_INSTANCE(gl_GlobalInvocationID.x);
+
 	vec3 particlePositions[MAX_VERTICES_PER_STRAND];
 	vec3 particleVelocities[MAX_VERTICES_PER_STRAND];
 
 	uint offset = gl_GlobalInvocationID.x * hairData.particlesPerStrand;
+	const float segmentLength = STRAND_SEGMENT_LENGTH(gl_GlobalInvocationID.x);
 
+#ifdef COMPACT_POSITIONS
+	particlePositions[0] = vec3(MODEL * vec4(loadRoot(gl_GlobalInvocationID.x), 1.f));
+	particleVelocities[0] = loadVelocity(offset);
+	for (uint i = 1; i < hairData.particlesPerStrand; ++i)
+	{
+		particlePositions[i] = particlePositions[i - 1] + segmentLength * decodeDirection(directions[offset + i]);
+		particleVelocities[i] = loadVelocity(offset + i);
+	}
+#else
 	for (uint i = 0; i < hairData.particlesPerStrand; ++i)
 	{
 		const uint particleOffset = offset + i;
@@ -231,14 +467,29 @@ void moveParticles()
 		particlePositions[i].z = positions[particleOffset][2];
 
 		// Velocities
-		particleVelocities[i].x = velocities[particleOffset][0];
-		particleVelocities[i].y = velocities[particleOffset][1];
-		particleVelocities[i].z = velocities[particleOffset][2];
+		particleVelocities[i] = loadVelocity(particleOffset);
 	}
 
-	particlePositions[0] = vec3(model * vec4(particlePositions[0], 1.f));
+	particlePositions[0] = vec3(MODEL * vec4(particlePositions[0], 1.f));
+#endif
 
 	vec3 forces, proposedPosition;
+#ifdef VERLET_INTEGRATION
+	// Particle velocities hold displacements, the FTL velocity correction of the previous particle is folded into the loop
+	vec3 positionCorrectionVector;
+	for (uint i = 1; i < hairData.particlesPerStrand; ++i) 
+	{
+		forces = generateWindForce(particlePositions[i]);
+		forces += generateGravityForce();
+		proposedPosition = integratePositionVerlet(forces, particlePositions[i], particleVelocities[i]);
+		proposedPosition = followTheLeader(particlePositions[i - 1], proposedPosition, segmentLength, positionCorrectionVector);
+		resolveBodyCollision(proposedPosition);
+		particleVelocities[i] = proposedPosition - particlePositions[i];
+		particlePositions[i] = proposedPosition;
+		if (i > 1)
+			particleVelocities[i - 1] -= VELOCITY_DAMPING_COEFFICIENT * positionCorrectionVector;
+	}
+#else
 	vec3 positionCorrectionVector[MAX_VERTICES_PER_STRAND];
 	for (uint i = 1; i < hairData.particlesPerStrand; ++i) 
 	{
@@ -246,7 +497,7 @@ void moveParticles()
 		forces += generateGravityForce();
 		proposedPosition = integrateHeun(forces, particlePositions[i], particleVelocities[i]);
 		// proposedPosition = integrateExplicitEuler(forces, particlePositions[i], particleVelocities[i]);
-		proposedPosition = followTheLeader(particlePositions[i - 1], proposedPosition, positionCorrectionVector[i]);
+		proposedPosition = followTheLeader(particlePositions[i - 1], proposedPosition, segmentLength, positionCorrectionVector[i]);
 		resolveBodyCollision(proposedPosition);
 		particleVelocities[i] = updateVelocity(particlePositions[i], proposedPosition);
 		particlePositions[i] = proposedPosition;
@@ -256,17 +507,21 @@ void moveParticles()
 	{
 		particleVelocities[i] = correctFtlVelocity(particleVelocities[i], positionCorrectionVector[i + 1]);
 	}
+#endif
 
 	for (uint i = 1; i < hairData.particlesPerStrand; ++i)
 	{
 		const uint particleOffset = offset + i;
+#ifdef COMPACT_POSITIONS
+		// The body collisions may have moved the particle off the segment length, the next decode restores it
+		directions[particleOffset] = encodeDirection(particlePositions[i] - particlePositions[i - 1]);
+#else
 		positions[particleOffset][0] = particlePositions[i].x;
 		positions[particleOffset][1] = particlePositions[i].y;
 		positions[particleOffset][2] = particlePositions[i].z;
+#endif
 
-		velocities[particleOffset][0] = particleVelocities[i].x;
-		velocities[particleOffset][1] = particleVelocities[i].y;
-		velocities[particleOffset][2] = particleVelocities[i].z;
+		storeVelocity(particleOffset, particleVelocities[i]);
 	}
 }
 
@@ -285,5 +540,11 @@ void main(void)
 		case COLLISIONS:
 			addHairFriction();
 			break;
+
+#ifdef HALF_VELOCITIES
+		case RESOLVE_VOLUMES:
+			resolveVolumes();
+			break;
+#endif
 	}
 }
@@ -0,0 +1,140 @@
+#version 460 core
+
+layout (local_size_x = 128) in;
+
+#ifdef COMPACT_POSITIONS
+#include "CompactPositions.glsl"
+#else
+layout (std430, binding = 0) readonly buffer HairPosition {
+	float positions[][3];
+};
+#endif
+
+struct DrawElementsIndirectCommand {
+	uint count;
+	uint instanceCount;
+	uint firstIndex;
+	int baseVertex;
+	uint baseInstance;
+};
+
+layout (std430, binding = 13) writeonly buffer DrawCommands {
+	DrawElementsIndirectCommand commands[];
+};
+
+// Also bound as the parameter buffer of glMultiDrawElementsIndirectCount
+layout (std430, binding = 14) buffer DrawCount {
+	uint drawCount;
+};
+
+// Fade and density compensation of every strand, read by the hair shaders compiled with STRAND_LOD
+layout (std430, binding = 18) writeonly buffer StrandOpacity {
+	float strandOpacities[];
+};
+
+uniform mat4 model;
+uniform vec4 frustumPlanes[6];
+uniform uint strandCount;
+uniform uint particlesPerStrand;
+
+// Level of detail, from the projected size of a sphere enclosing the head and the hanging strands
+uniform bool lodEnabled;
+uniform vec3 cameraPosition;
+uniform float projectionScale;			// projection[1][1], turns radius over distance into a fraction of the screen
+uniform float boundsRadius;
+uniform float fullDetailSize;			// Projected size from which every strand is drawn
+uniform float minimumStrandFraction;
+uniform float fadeBand;					// Fraction of the strands fading in below the selection threshold
+uniform bool opacityCompensation;		// Otherwise the missing strands are made up for by wider lines
+uniform float levelSizes[2];			// Projected sizes below which strands switch to the decimated index patterns
+uniform float levelBand;				// Relative size range around a level size over which the strands switch
+uniform uint levelFirstIndices[3];
+uniform uint levelCounts[3];
+
+bool isSphereVisible(in vec3 center, in float radius)
+{
+	for (uint i = 0; i < 6; ++i)
+	{
+		if (dot(frustumPlanes[i].xyz, center) + frustumPlanes[i].w < -radius)
+			return false;
+	}
+
+	return true;
+}
+
+// Deterministic value in [0, 1) per strand, so the same strands survive from frame to frame
+float strandHash(in uint strand)
+{
+	uint hash = strand * 747796405u + 2891336453u;
+	hash = ((hash >> ((hash >> 28u) + 4u)) ^ hash) * 277803737u;
+	hash = (hash >> 22u) ^ hash;
+	return float(hash) / 4294967296.0;
+}
+
+void main(void)
+{
+	const uint strand = gl_GlobalInvocationID.x;
+	if (strand >= strandCount)
+		return;
+
+	const uint offset = strand * particlesPerStrand;
+
+#ifdef COMPACT_POSITIONS
+	// The strand is walked from its root, every segment has the strand's rest length
+	vec3 particlePosition = vec3(model * vec4(loadRoot(strand), 1.f));
+	vec3 boundsMin = particlePosition;
+	vec3 boundsMax = particlePosition;
+	for (uint i = 1; i < particlesPerStrand; ++i)
+	{
+		particlePosition += segmentLengths[strand] * decodeDirection(directions[offset + i]);
+		boundsMin = min(boundsMin, particlePosition);
+		boundsMax = max(boundsMax, particlePosition);
+	}
+#else
+	// Roots are stored in model space, the rest of the strand is already in world space
+	const vec3 root = vec3(model * vec4(positions[offset][0], positions[offset][1], positions[offset][2], 1.f));
+	vec3 boundsMin = root;
+	vec3 boundsMax = root;
+	for (uint i = 1; i < particlesPerStrand; ++i)
+	{
+		const vec3 particlePosition = vec3(positions[offset + i][0], positions[offset + i][1], positions[offset + i][2]);
+		boundsMin = min(boundsMin, particlePosition);
+		boundsMax = max(boundsMax, particlePosition);
+	}
+#endif
+
+	if (!isSphereVisible((boundsMin + boundsMax) * 0.5, length(boundsMax - boundsMin) * 0.5))
+		return;
+
+	uint level = 0;
+	float opacity = 1.0;
+	if (lodEnabled)
+	{
+		const float projectedSize = boundsRadius * projectionScale / max(distance(cameraPosition, vec3(model[3])), 1e-3);
+		const float density = clamp(projectedSize / fullDetailSize, minimumStrandFraction, 1.0);
+		const float threshold = density * (1.0 + fadeBand);
+		const float hash = strandHash(strand);
+		if (hash >= threshold)
+			return;
+
+		// Strands close to the threshold fade in, the survivors are denser to keep the overall coverage.
+		// The threshold goes past 1 by the fade band, so at full detail no strand is faded.
+		opacity = clamp((threshold - hash) / fadeBand, 0.0, 1.0);
+		if (opacityCompensation)
+			opacity /= density;
+
+		// Across the band around a level size the strands switch to the next level one by one, in the order of a
+		// second hash, so the whole hair never changes its pattern in a single frame
+		const float levelHash = strandHash(strand ^ 0x9e3779b9u);
+		for (uint i = 0; i < 2; ++i)
+		{
+			const float bandEnd = levelSizes[i] * (1.0 + levelBand);
+			if (levelHash < clamp((bandEnd - projectedSize) / (2.0 * levelBand * levelSizes[i]), 0.0, 1.0))
+				level = i + 1;
+		}
+	}
+
+	strandOpacities[strand] = opacity;
+	const uint command = atomicAdd(drawCount, 1);
+	commands[command] = DrawElementsIndirectCommand(levelCounts[level], 1, levelFirstIndices[level], int(offset), strand);
+}
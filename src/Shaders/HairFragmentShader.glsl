@@ -1,8 +1,142 @@
 #version 460 core
 
+in Attributes {
+	vec3 fragPosition;
+	vec3 tangent;
+#ifdef RIBBONS
+	float side;
+	float coverage;
+#endif
+#ifdef STRAND_LOD
+	float opacity;			// Fade and density compensation of the strand level of detail
+#endif
+} inAttributes;
+
+#if defined(WEIGHTED_OIT)
+layout (location = 0) out vec4 accumulation;
+layout (location = 1) out float revealage;
+#elif defined(LINKED_LIST_OIT)
+layout (early_fragment_tests) in;
+
+struct FragmentNode {
+	uint color;			// RGBA8, alpha already includes the strand alpha
+	float depth;
+	uint next;
+};
+
+layout (std430, binding = 16) writeonly buffer FragmentNodes {
+	FragmentNode nodes[];
+};
+
+layout (std430, binding = 17) buffer FragmentNodeCount {
+	uint nodeCount;
+};
+
+layout (r32ui, binding = 1) uniform coherent uimage2D headPointers;
+uniform uint maxNodeCount;
+#else
 out vec4 fragColor;
+#endif
+
+uniform float strandAlpha = 0.35;		// Only used by the order independent transparency variants
+
+uniform sampler2D shadingLut;		// Kajiya-Kay terms, red is sin(T, L), green is sin(T, H)^exponent
+uniform vec3 lightPosition;
+uniform vec3 lightColor;
+uniform vec3 hairColor;
+uniform vec3 cameraPosition;
+uniform float ambientStrength = 0.25;
+uniform float specularStrength = 0.6;
+
+#ifdef SELF_SHADOWING
+uniform sampler2D opacityDepth;
+uniform sampler2D opacityLayers;		// Cumulative opacity up to the end of each layer
+uniform mat4 lightViewProjection;
+uniform float lightDepthRange;
+uniform vec4 opacityLayerEnds;
+uniform float shadowDensity = 1.5;
+
+// Fraction of the light reaching the fragment through the strands in front of it, from the deep opacity maps
+float lightTransmittance()
+{
+	const vec3 lightSpace = (lightViewProjection * vec4(inAttributes.fragPosition, 1.0)).xyz * 0.5 + 0.5;
+	const float depthBehindFirst = max(lightSpace.z - texture(opacityDepth, lightSpace.xy).r, 0.0) * lightDepthRange;
+	const vec4 layers = texture(opacityLayers, lightSpace.xy);
+
+	float opacity = layers.w;
+	float layerStart = 0.0;
+	float startOpacity = 0.0;
+	for (int i = 0; i < 4; ++i)
+	{
+		if (depthBehindFirst < opacityLayerEnds[i])
+		{
+			opacity = mix(startOpacity, layers[i], (depthBehindFirst - layerStart) / (opacityLayerEnds[i] - layerStart));
+			break;
+		}
+		layerStart = opacityLayerEnds[i];
+		startOpacity = layers[i];
+	}
+
+	return exp(-shadowDensity * opacity);
+}
+#endif
+
+vec3 shadeKajiyaKay(in vec3 tangent)
+{
+	const vec3 lightDirection = normalize(lightPosition - inAttributes.fragPosition);
+	const vec3 viewDirection = normalize(cameraPosition - inAttributes.fragPosition);
+	const vec3 halfVector = normalize(lightDirection + viewDirection);
+	const vec2 terms = texture(shadingLut, vec2(dot(tangent, lightDirection), dot(tangent, halfVector)) * 0.5 + 0.5).rg;
+
+#ifdef SELF_SHADOWING
+	const float transmittance = lightTransmittance();
+#else
+	const float transmittance = 1.0;
+#endif
+	return hairColor * (ambientStrength + transmittance * terms.r) * lightColor + transmittance * specularStrength * terms.g * lightColor;
+}
+
+#if defined(WEIGHTED_OIT)
+void writeFragment(in vec4 color)
+{
+	const float alpha = min(color.a * strandAlpha, 1.0);
+	// Depth weight of McGuire and Bavoil, so the closest strands dominate the blended average
+	const float weight = alpha * clamp(3e3 * pow(1.0 - gl_FragCoord.z, 3.0), 1e-2, 3e3);
+	accumulation = vec4(color.rgb * alpha, alpha) * weight;
+	revealage = alpha;
+}
+#elif defined(LINKED_LIST_OIT)
+void writeFragment(in vec4 color)
+{
+	const uint node = atomicAdd(nodeCount, 1);
+	if (node >= maxNodeCount)
+		return;
+
+	const uint next = imageAtomicExchange(headPointers, ivec2(gl_FragCoord.xy), node);
+	nodes[node] = FragmentNode(packUnorm4x8(vec4(color.rgb, min(color.a * strandAlpha, 1.0))), gl_FragCoord.z, next);
+}
+#else
+void writeFragment(in vec4 color)
+{
+	fragColor = vec4(color.rgb, min(color.a, 1.0));
+}
+#endif
 
 void main()
 {
-	fragColor = vec4(0,0,0,1);
-}
\ No newline at end of file
+	const vec3 color = shadeKajiyaKay(normalize(inAttributes.tangent));
+#ifdef RIBBONS
+	// Analytic coverage of the ribbon edges, in pixels from the closest edge, replaces multisampling
+	const float edgeDistance = (1.0 - abs(inAttributes.side)) / max(fwidth(inAttributes.side), 1e-5);
+	float alpha = inAttributes.coverage * clamp(edgeDistance + 0.5, 0.0, 1.0);
+#else
+	float alpha = 1.0;
+#endif
+#ifdef STRAND_LOD
+	// Above 1 for denser surviving strands, the transparency modes apply it before clamping.
+	// Opaque hair is compensated with wider lines, and turns the fade into sample coverage with alpha to coverage.
+	alpha *= inAttributes.opacity;
+#endif
+	writeFragment(vec4(color, alpha));
+}
+
@@ -7,11 +7,17 @@ layout(line_strip, max_vertices = VERTICES_BETWEEN) out;
 in Attributes {
 	vec3 fragPosition;
 	vec3 tangent;
+#ifdef STRAND_LOD
+	float opacity;
+#endif
 } inAttributes[];
 
 out Attributes {
 	vec3 fragPosition;
 	vec3 tangent;
+#ifdef STRAND_LOD
+	float opacity;
+#endif
 } outAttributes;
 
 uniform mat4 projection;
@@ -22,11 +28,17 @@ void main(void)
 	gl_Position = projection * view * vec4(gl_in[0].gl_Position.xyz, 1.f);
 	outAttributes.fragPosition = inAttributes[0].fragPosition;
 	outAttributes.tangent = normalize(inAttributes[1].fragPosition - inAttributes[0].fragPosition);
+#ifdef STRAND_LOD
+	outAttributes.opacity = inAttributes[0].opacity;
+#endif
 	EmitVertex();
 
 	gl_Position = projection * view * vec4(gl_in[1].gl_Position.xyz, 1.f);
 	outAttributes.fragPosition = inAttributes[1].fragPosition;
 	outAttributes.tangent = normalize(inAttributes[1].fragPosition - inAttributes[0].fragPosition);
+#ifdef STRAND_LOD
+	outAttributes.opacity = inAttributes[0].opacity;
+#endif
 	EmitVertex();
 
 	EndPrimitive();
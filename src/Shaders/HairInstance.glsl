@@ -0,0 +1,24 @@
+// Per instance table of BATCHED hairs, included by every shader that reads the strands of a batch. Matches
+// HairInstanceData in HairBatch.h.
+
+struct HairInstance {
+	mat4 model;
+	vec4 wind;
+	float gravity;
+	float frictionCoefficient;
+	float velocityDampingCoefficient;
+	uint strandOffset;
+	uint strandCount;
+	uint colliderOffset;
+	uint colliderCount;
+	uint padding;
+};
+
+layout (std430, binding = 9) readonly buffer HairInstances {
+	HairInstance instances[];
+};
+
+// Instance of every strand
+layout (std430, binding = 10) readonly buffer StrandInstance {
+	uint strandInstances[];
+};
@@ -0,0 +1,86 @@
+#version 460 core
+
+layout (local_size_x = 256) in;
+
+#ifdef COMPACT_POSITIONS
+#include "CompactPositions.glsl"
+#else
+layout (std430, binding = 0) readonly buffer HairPosition {
+	float positions[][3];
+};
+#endif
+
+struct RibbonVertex {
+	vec4 position;		// w is the side of the ribbon, -1 or 1
+	vec4 tangent;		// w is the fraction of the expanded width covered by the strand
+};
+
+layout (std430, binding = 15) writeonly buffer RibbonVertices {
+	RibbonVertex ribbonVertices[];
+};
+
+uniform mat4 model;
+uniform vec3 cameraPosition;
+uniform uint particleCount;
+uniform uint particlesPerStrand;
+uniform float rootWidth;
+uniform float tipWidthScale;
+uniform float pixelSize;		// World space size of a pixel at unit distance from the camera
+
+#ifndef COMPACT_POSITIONS
+vec3 fetchPosition(in uint index)
+{
+	const vec3 position = vec3(positions[index][0], positions[index][1], positions[index][2]);
+	if (index % particlesPerStrand == 0)
+		return vec3(model * vec4(position, 1.f));
+
+	return position;
+}
+#endif
+
+void writeRibbonVertices(in uint index, in vec3 position, in vec3 tangent)
+{
+	const uint particle = index % particlesPerStrand;
+
+	// Winding of the quads is counter clockwise when seen from the camera
+	const vec3 side = cross(tangent, cameraPosition - position);
+	const float sideLength = length(side);
+	const vec3 sideDirection = sideLength > 1e-6 ? side / sideLength : vec3(0.0);
+
+	// Ribbons thinner than a pixel are widened to one pixel and faded by the width they lost
+	const float width = rootWidth * mix(1.0, tipWidthScale, float(particle) / float(particlesPerStrand - 1));
+	const float expandedWidth = max(width, pixelSize * distance(cameraPosition, position));
+	const vec3 offset = sideDirection * expandedWidth * 0.5;
+
+	ribbonVertices[index * 2] = RibbonVertex(vec4(position - offset, -1.0), vec4(tangent, width / expandedWidth));
+	ribbonVertices[index * 2 + 1] = RibbonVertex(vec4(position + offset, 1.0), vec4(tangent, width / expandedWidth));
+}
+
+void main(void)
+{
+#ifdef COMPACT_POSITIONS
+	// One invocation per strand, every particle is decoded once on the walk from the root. The direction of the
+	// segment leaving a particle is its tangent, the tip keeps the one of the last segment.
+	const uint strand = gl_GlobalInvocationID.x;
+	if (strand >= particleCount / particlesPerStrand)
+		return;
+
+	const uint offset = strand * particlesPerStrand;
+	vec3 position = vec3(model * vec4(loadRoot(strand), 1.f));
+	for (uint particle = 0; particle < particlesPerStrand; ++particle)
+	{
+		const vec3 tangent = decodeDirection(directions[offset + min(particle + 1, particlesPerStrand - 1)]);
+		writeRibbonVertices(offset + particle, position, tangent);
+		position += segmentLengths[strand] * tangent;
+	}
+#else
+	const uint index = gl_GlobalInvocationID.x;
+	if (index >= particleCount)
+		return;
+
+	const vec3 position = fetchPosition(index);
+	const vec3 tangent = index % particlesPerStrand == particlesPerStrand - 1 ? normalize(position - fetchPosition(index - 1))
+		: normalize(fetchPosition(index + 1) - position);
+	writeRibbonVertices(index, position, tangent);
+#endif
+}
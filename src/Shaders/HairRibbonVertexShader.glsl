@@ -0,0 +1,24 @@
+#version 460 core
+
+layout (location = 0) in vec4 inPosition;
+layout (location = 1) in vec4 inTangent;
+
+out Attributes {
+	vec3 fragPosition;
+	vec3 tangent;
+	float side;
+	float coverage;
+} outAttributes;
+
+uniform mat4 projection;
+uniform mat4 view;
+
+void main()
+{
+	outAttributes.fragPosition = inPosition.xyz;
+	outAttributes.tangent = inTangent.xyz;
+	outAttributes.side = inPosition.w;
+	outAttributes.coverage = inTangent.w;
+
+	gl_Position = projection * view * vec4(inPosition.xyz, 1.f);
+}
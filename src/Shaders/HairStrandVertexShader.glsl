@@ -0,0 +1,79 @@
+#version 460 core
+
+// Vertex pulling variant of HairVertexShader, draws the line strips without a geometry stage.
+// Positions are read from the particle buffer so the tangent can use the neighbouring particle.
+
+#ifdef COMPACT_POSITIONS
+#include "CompactPositions.glsl"
+
+// World space positions decoded once per step by the collision pass
+layout (std430, binding = 21) readonly buffer DecodedPosition {
+	float decodedPositions[][3];
+};
+#else
+layout (std430, binding = 0) readonly buffer HairPosition {
+	float positions[][3];
+};
+#endif
+
+out Attributes {
+	vec3 fragPosition;
+	vec3 tangent;
+#ifdef STRAND_LOD
+	float opacity;
+#endif
+} outAttributes;
+
+#ifdef STRAND_LOD
+layout (std430, binding = 18) readonly buffer StrandOpacity {
+	float strandOpacities[];
+};
+#endif
+
+#ifdef BATCHED
+#include "HairInstance.glsl"
+
+#define MODEL(strand) instances[strandInstances[strand]].model
+#else
+#define MODEL(strand) model
+#endif
+
+uniform mat4 model;
+uniform mat4 projection;
+uniform mat4 view;
+uniform uint particlesPerStrand;
+
+vec3 fetchPosition(in uint index)
+{
+#ifdef COMPACT_POSITIONS
+	return vec3(decodedPositions[index][0], decodedPositions[index][1], decodedPositions[index][2]);
+#else
+	const vec3 position = vec3(positions[index][0], positions[index][1], positions[index][2]);
+	if (index % particlesPerStrand == 0)
+		return vec3(MODEL(index / particlesPerStrand) * vec4(position, 1.f));
+
+	return position;
+#endif
+}
+
+void main()
+{
+	const uint index = uint(gl_VertexID);
+	outAttributes.fragPosition = fetchPosition(index);
+#ifdef COMPACT_POSITIONS
+	// The tangent is the direction of the segment leaving the particle, the tip keeps the one of the last segment
+	const bool tip = index % particlesPerStrand == particlesPerStrand - 1;
+	outAttributes.tangent = decodeDirection(directions[tip ? index : index + 1]);
+#else
+	if (index % particlesPerStrand == particlesPerStrand - 1)
+		outAttributes.tangent = normalize(outAttributes.fragPosition - fetchPosition(index - 1));
+	else
+		outAttributes.tangent = normalize(fetchPosition(index + 1) - outAttributes.fragPosition);
+#endif
+
+#ifdef STRAND_LOD
+	outAttributes.opacity = strandOpacities[index / particlesPerStrand];
+#endif
+
+	gl_Position = projection * view * vec4(outAttributes.fragPosition, 1.f);
+}
@@ -0,0 +1,36 @@
+#version 460 core
+
+// Every patch is one strand segment with its two neighbours, the segment is subdivided by its length on screen
+layout (vertices = 4) out;
+
+in Attributes {
+	vec3 fragPosition;
+	vec3 tangent;
+} inAttributes[];
+
+out ControlPoint {
+	vec3 position;
+} outControlPoints[];
+
+uniform mat4 projection;
+uniform mat4 view;
+uniform vec2 viewportSize;
+uniform float pixelsPerSubdivision = 6.0;
+uniform float maxSubdivisions = 32.0;
+
+vec2 toScreen(in vec3 position)
+{
+	const vec4 clipPosition = projection * view * vec4(position, 1.0);
+	return clipPosition.xy / max(clipPosition.w, 1e-4) * 0.5 * viewportSize;
+}
+
+void main()
+{
+	outControlPoints[gl_InvocationID].position = inAttributes[gl_InvocationID].fragPosition;
+	if (gl_InvocationID == 0)
+	{
+		const float screenLength = distance(toScreen(inAttributes[1].fragPosition), toScreen(inAttributes[2].fragPosition));
+		gl_TessLevelOuter[0] = 1.0;
+		gl_TessLevelOuter[1] = clamp(ceil(screenLength / pixelsPerSubdivision), 1.0, maxSubdivisions);
+	}
+}
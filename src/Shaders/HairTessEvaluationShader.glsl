@@ -0,0 +1,35 @@
+#version 460 core
+
+layout (isolines, equal_spacing) in;
+
+in ControlPoint {
+	vec3 position;
+} inControlPoints[];
+
+out Attributes {
+	vec3 fragPosition;
+	vec3 tangent;
+} outAttributes;
+
+uniform mat4 projection;
+uniform mat4 view;
+
+// Uniform Catmull-Rom spline through the particles, the segment runs from control point 1 to 2
+void main()
+{
+	const float t = gl_TessCoord.x;
+	const vec3 p0 = inControlPoints[0].position;
+	const vec3 p1 = inControlPoints[1].position;
+	const vec3 p2 = inControlPoints[2].position;
+	const vec3 p3 = inControlPoints[3].position;
+
+	const vec3 a = 2.0 * p1;
+	const vec3 b = p2 - p0;
+	const vec3 c = 2.0 * p0 - 5.0 * p1 + 4.0 * p2 - p3;
+	const vec3 d = -p0 + 3.0 * p1 - 3.0 * p2 + p3;
+	outAttributes.fragPosition = 0.5 * (a + b * t + c * t * t + d * t * t * t);
+	const vec3 derivative = 0.5 * (b + 2.0 * c * t + 3.0 * d * t * t);
+	outAttributes.tangent = length(derivative) > 1e-6 ? normalize(derivative) : normalize(p2 - p1);
+
+	gl_Position = projection * view * vec4(outAttributes.fragPosition, 1.0);
+}
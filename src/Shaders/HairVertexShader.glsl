@@ -5,18 +5,39 @@ layout (location = 0) in vec3 inPosition;
 out Attributes {
 	vec3 fragPosition;
 	vec3 tangent;
+#ifdef STRAND_LOD
+	float opacity;
+#endif
 } outAttributes;
 
+#ifdef STRAND_LOD
+layout (std430, binding = 18) readonly buffer StrandOpacity {
+	float strandOpacities[];
+};
+#endif
+
+#ifdef BATCHED
+#include "HairInstance.glsl"
+
+#define MODEL instances[strandInstances[gl_VertexID / particlesPerStrand]].model
+#else
+#define MODEL model
+#endif
+
 uniform mat4 model;
 uniform uint particlesPerStrand;
 
 void main() 
 {
 	if (gl_VertexID % particlesPerStrand == 0) {
-		outAttributes.fragPosition = vec3(model * vec4(inPosition, 1.f));
+		outAttributes.fragPosition = vec3(MODEL * vec4(inPosition, 1.f));
 	} else {
 		outAttributes.fragPosition = inPosition;
 	}
 
+#ifdef STRAND_LOD
+	outAttributes.opacity = strandOpacities[gl_VertexID / particlesPerStrand];
+#endif
+
 	gl_Position = vec4(outAttributes.fragPosition, 1.f);
 }
\ No newline at end of file
@@ -0,0 +1,22 @@
+#version 460 core
+
+// The head is the depth prepass of the hair, nothing here may discard or write depth so early tests stay enabled
+layout (early_fragment_tests) in;
+
+in vec3 fragPosition;
+in vec3 fragNormal;
+
+uniform vec3 headColor;
+uniform vec3 lightPosition;
+uniform vec3 lightColor;
+uniform float ambientStrength = 0.25;
+
+out vec4 fragColor;
+
+void main()
+{
+	const vec3 normal = normalize(fragNormal);
+	const vec3 lightDirection = normalize(lightPosition - fragPosition);
+	const float diffuse = max(dot(normal, lightDirection), 0.0);
+	fragColor = vec4(headColor * (ambientStrength + diffuse * lightColor), 1.0);
+}
@@ -0,0 +1,20 @@
+#version 460 core
+
+layout (location = 0) in vec3 position;
+layout (location = 1) in vec3 normal;
+
+uniform mat4 projection;
+uniform mat4 view;
+uniform mat4 model;
+uniform mat3 normalMatrix;		// Inverse transpose of the model matrix, computed once per draw on the CPU
+
+out vec3 fragPosition;
+out vec3 fragNormal;
+
+void main()
+{
+	const vec4 worldPosition = model * vec4(position, 1.0);
+	fragPosition = worldPosition.xyz;
+	fragNormal = normalMatrix * normal;
+	gl_Position = projection * view * worldPosition;
+}
@@ -0,0 +1,73 @@
+#version 460 core
+
+// Composites the transparent hair over the framebuffer, blended with (GL_ONE, GL_SRC_ALPHA):
+// rgb is the premultiplied hair color and alpha the fraction of the background still visible
+out vec4 fragColor;
+
+#ifdef LINKED_LIST_OIT
+#define MAX_FRAGMENTS 32u
+
+struct FragmentNode {
+	uint color;
+	float depth;
+	uint next;
+};
+
+layout (std430, binding = 16) readonly buffer FragmentNodes {
+	FragmentNode nodes[];
+};
+
+layout (r32ui, binding = 1) uniform readonly uimage2D headPointers;
+
+void main()
+{
+	// The whole list is walked and the nearest MAX_FRAGMENTS fragments are kept, insertion sorted front to back.
+	// Farther fragments of deeper lists are dropped, they sit behind enough hair to be barely visible.
+	uint colors[MAX_FRAGMENTS];
+	float depths[MAX_FRAGMENTS];
+	uint count = 0;
+	for (uint node = imageLoad(headPointers, ivec2(gl_FragCoord.xy)).r; node != 0xFFFFFFFFu; node = nodes[node].next)
+	{
+		const float depth = nodes[node].depth;
+		if (count == MAX_FRAGMENTS && depth >= depths[MAX_FRAGMENTS - 1u])
+			continue;
+
+		int j = int(min(count, MAX_FRAGMENTS - 1u)) - 1;
+		for (; j >= 0 && depths[j] > depth; --j)
+		{
+			colors[j + 1] = colors[j];
+			depths[j + 1] = depths[j];
+		}
+		colors[j + 1] = nodes[node].color;
+		depths[j + 1] = depth;
+		count = min(count + 1, MAX_FRAGMENTS);
+	}
+
+	if (count == 0)
+		discard;
+
+	vec3 color = vec3(0.0);
+	float transmittance = 1.0;
+	for (uint i = 0; i < count; ++i)
+	{
+		const vec4 fragment = unpackUnorm4x8(colors[i]);
+		color += transmittance * fragment.a * fragment.rgb;
+		transmittance *= 1.0 - fragment.a;
+	}
+
+	fragColor = vec4(color, transmittance);
+}
+#else
+uniform sampler2D accumulationTexture;
+uniform sampler2D revealageTexture;
+
+void main()
+{
+	const float revealage = texelFetch(revealageTexture, ivec2(gl_FragCoord.xy), 0).r;
+	if (revealage == 1.0)
+		discard;
+
+	const vec4 accumulation = texelFetch(accumulationTexture, ivec2(gl_FragCoord.xy), 0);
+	fragColor = vec4(accumulation.rgb / max(accumulation.a, 1e-5) * (1.0 - revealage), revealage);
+}
+#endif
@@ -0,0 +1,8 @@
+#version 460 core
+
+// Fullscreen triangle, drawn without vertex attributes
+void main()
+{
+	const vec2 position = vec2((gl_VertexID << 1) & 2, gl_VertexID & 2);
+	gl_Position = vec4(position * 2.0 - 1.0, 0.0, 1.0);
+}
@@ -0,0 +1,43 @@
+#version 460 core
+
+layout (local_size_x = 4, local_size_y = 4, local_size_z = 4) in;
+
+layout (rgba16f, binding = 0) uniform writeonly image3D windField;
+
+uniform vec3 fieldMin;
+uniform float fieldSize;
+uniform float runningTime;
+uniform float frequency = 1.5;
+
+vec3 potential(in vec3 position)
+{
+	const vec3 p = position * frequency;
+	return vec3(
+		sin(p.y + runningTime) * cos(p.z * 1.3 - runningTime * 0.7),
+		sin(p.z + runningTime * 1.1) * cos(p.x * 0.9 + runningTime * 0.5),
+		sin(p.x - runningTime * 0.8) * cos(p.y * 1.2 + runningTime * 0.3)
+	);
+}
+
+// Curl of the potential is divergence free, so the wind swirls around the hair instead of pushing it into sinks
+vec3 curlNoise(in vec3 position)
+{
+	const float e = 0.05;
+	const vec3 dx = potential(position + vec3(e, 0.0, 0.0)) - potential(position - vec3(e, 0.0, 0.0));
+	const vec3 dy = potential(position + vec3(0.0, e, 0.0)) - potential(position - vec3(0.0, e, 0.0));
+	const vec3 dz = potential(position + vec3(0.0, 0.0, e)) - potential(position - vec3(0.0, 0.0, e));
+	return vec3(dy.z - dz.y, dz.x - dx.z, dx.y - dy.x) / (2.0 * e);
+}
+
+void main(void)
+{
+	const ivec3 size = imageSize(windField);
+	const ivec3 texel = ivec3(gl_GlobalInvocationID);
+	if (any(greaterThanEqual(texel, size)))
+		return;
+
+	const vec3 position = fieldMin + (vec3(texel) + 0.5) / vec3(size) * fieldSize;
+	const vec3 wind = curlNoise(position);
+	const float windLength = length(wind);
+	imageStore(windField, texel, vec4(windLength > 0.0 ? wind / windLength : vec3(0.0), 0.0));
+}
@@ -0,0 +1,13 @@
+#pragma once
+#include "Shader.h"
+
+// Drawing program with tessellation control and evaluation stages, drawn with GL_PATCHES
+class TessellationShader : public Shader {
+public:
+	TessellationShader(const std::string& vertexShaderFile, const std::string& controlShaderFile, const std::string& evaluationShaderFile,
+		const std::string& fragmentShaderFile, const std::vector<std::string>& defines = {}) {
+        buildProgram({ { GL_VERTEX_SHADER, vertexShaderFile }, { GL_TESS_CONTROL_SHADER, controlShaderFile },
+            { GL_TESS_EVALUATION_SHADER, evaluationShaderFile }, { GL_FRAGMENT_SHADER, fragmentShaderFile } }, defines);
+    }
+	~TessellationShader() override = default;
+};
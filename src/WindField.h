@@ -0,0 +1,92 @@
+#pragma once
+#include "ComputeShader.h"
+#include <fstream>
+
+const uint32_t WIND_FIELD_RESOLUTION = 32U;
+const float WIND_FIELD_SIZE = 10.f;				// Same [-5, 5] domain as the friction grid
+
+// Low resolution 3D texture of unit wind directions, sampled with trilinear filtering by the solver.
+// The field is regenerated from curl noise once per frame, unless a baked volume was loaded from disk.
+// Baked volumes are raw files: "WIND", 3 uint32 resolutions, then RGB floats with x varying fastest.
+class WindField {
+public:
+	WindField() : computeShader("WindFieldShader.glsl") {
+        computeShader.use();
+        computeShader.setVec3("fieldMin", fieldMin);
+        computeShader.setFloat("fieldSize", WIND_FIELD_SIZE);
+        createTexture(glm::ivec3(WIND_FIELD_RESOLUTION));
+    }
+	~WindField() {
+        glDeleteTextures(1, &texture);
+    }
+	WindField(const WindField&) = delete;
+	WindField& operator=(const WindField&) = delete;
+
+	void update(float runningTime) {
+        if (baked)
+            return;
+
+        computeShader.use();
+        computeShader.setFloat("runningTime", runningTime);
+        const glm::ivec3 localSize = computeShader.getLocalWorkGroupsCount();
+        computeShader.setGlobalWorkGroupCount((resolution.x + localSize.x - 1) / localSize.x, (resolution.y + localSize.y - 1) / localSize.y,
+            (resolution.z + localSize.z - 1) / localSize.z);
+        glBindImageTexture(0, texture, 0, GL_TRUE, 0, GL_WRITE_ONLY, GL_RGBA16F);
+        computeShader.dispatch();
+        glMemoryBarrier(GL_TEXTURE_FETCH_BARRIER_BIT);
+    }
+
+	bool loadFromFile(const std::string& path);
+
+	void bind(GLuint textureUnit) const {
+        glBindTextureUnit(textureUnit, texture);
+    }
+	const glm::vec3& getMin() const { return fieldMin; }
+	float getSize() const { return WIND_FIELD_SIZE; }
+	bool isBaked() const { return baked; }
+
+private:
+	void createTexture(const glm::ivec3& _resolution) {
+        glDeleteTextures(1, &texture);
+        resolution = _resolution;
+        glCreateTextures(GL_TEXTURE_3D, 1, &texture);
+        glTextureStorage3D(texture, 1, GL_RGBA16F, resolution.x, resolution.y, resolution.z);
+        glTextureParameteri(texture, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+        glTextureParameteri(texture, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        glTextureParameteri(texture, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        glTextureParameteri(texture, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+        glTextureParameteri(texture, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE);
+    }
+
+	ComputeShader computeShader;
+	GLuint texture = GL_NONE;
+	glm::ivec3 resolution{ 0 };
+	glm::vec3 fieldMin{ -WIND_FIELD_SIZE / 2.f };
+	bool baked = false;
+};
+
+inline bool WindField::loadFromFile(const std::string& path)
+{
+    std::ifstream file(path, std::ios::binary);
+    char magic[4];
+    uint32_t fileResolution[3];
+    if (!file.read(magic, sizeof(magic)) || std::string(magic, sizeof(magic)) != "WIND" ||
+        !file.read(reinterpret_cast<char*>(fileResolution), sizeof(fileResolution)))
+    {
+        std::cout << "Failed to read wind volume: " << path << std::endl;
+        return false;
+    }
+
+    std::vector<float> data(static_cast<size_t>(fileResolution[0]) * fileResolution[1] * fileResolution[2] * 3);
+    if (data.empty() || !file.read(reinterpret_cast<char*>(data.data()), data.size() * sizeof(float)))
+    {
+        std::cout << "Wind volume is truncated: " << path << std::endl;
+        return false;
+    }
+
+    createTexture(glm::ivec3(fileResolution[0], fileResolution[1], fileResolution[2]));
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+    glTextureSubImage3D(texture, 0, 0, 0, 0, resolution.x, resolution.y, resolution.z, GL_RGB, GL_FLOAT, data.data());
+    baked = true;
+    return true;
+}
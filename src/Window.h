@@ -15,12 +15,14 @@ struct Time {
 
 class Window {
 public:
-	Window(uint32_t winWidth = 1024, uint32_t winHeight = 768, const char* winName = "MyApplication", int sampleCount = 1) {
+	Window(uint32_t winWidth = 1024, uint32_t winHeight = 768, const char* winName = "MyApplication", int sampleCount = 1, bool visible = true) {
         if (!glfwInit()) {
             std::cerr << ">> Failed to initialize GLFW\n";
             exit(-1);
         }
         glfwWindowHint(GLFW_SAMPLES, sampleCount);
+        // A hidden window still owns a context, which is all offscreen rendering needs
+        glfwWindowHint(GLFW_VISIBLE, visible ? GLFW_TRUE : GLFW_FALSE);
 
         this->windowHandle = glfwCreateWindow(winWidth, winHeight, winName, nullptr, nullptr);
         if(this->windowHandle == nullptr) {
@@ -59,6 +61,7 @@ public:
     }
 
 	bool shouldClose() const { return glfwWindowShouldClose(windowHandle); }
+	bool isKeyPressed(int key) const { return glfwGetKey(windowHandle, key) == GLFW_PRESS; }
 	const Time& getTime() const { return tm; }
 
 private:
@@ -1,15 +1,179 @@
 #include "Window.h"
 #include "Camera.h"
 #include "DrawingShader.h"
+#include "GpuProfiler.h"
 #include "Hair.h"
+#include "HairBatch.h"
+#include "HairBenchmark.h"
+#include "HairCachePlayer.h"
+#include "HairCacheWriter.h"
+#include "HairCheckpoint.h"
+#include "HairShading.h"
+#include "DeepOpacityMap.h"
+#include "FrameCapture.h"
+#include "HairTransparency.h"
+#include "TessellationShader.h"
+#include <cmath>
+#include <limits>
 #include <memory>
+#include <string>
+#include <vector>
 
 template<typename T> using Unique = std::unique_ptr<T>;
 
-int main()
+const float LIGHT_SPEED = 4.f;		// Units per second while an arrow key is held
+
+// Reads the value of a numeric option, keeps the default and reports it when the value isn't a number
+bool parseOption(const std::string& option, const std::string& value, float& result)
+{
+	try
+	{
+		size_t length = 0;
+		const float parsed = std::stof(value, &length);
+		if (length == value.size() && std::isfinite(parsed))
+		{
+			result = parsed;
+			return true;
+		}
+	}
+	catch (const std::exception&)
+	{
+	}
+	std::cout << "Invalid value '" << value << "' for " << option << ", expected a number" << std::endl;
+	return false;
+}
+
+bool parseOption(const std::string& option, const std::string& value, uint32_t& result)
 {
-	auto window = std::make_unique<Window>(1440, 810, "Hair Simulation", 4);
-	glEnable(GL_MULTISAMPLE);
+	try
+	{
+		size_t length = 0;
+		const unsigned long parsed = std::stoul(value, &length);
+		if (length == value.size() && value[0] != '-' && parsed <= std::numeric_limits<uint32_t>::max())
+		{
+			result = static_cast<uint32_t>(parsed);
+			return true;
+		}
+	}
+	catch (const std::exception&)
+	{
+	}
+	std::cout << "Invalid value '" << value << "' for " << option << ", expected a positive integer" << std::endl;
+	return false;
+}
+
+int main(int argc, char* argv[])
+{
+	uint32_t crowdSize = 0;		// Characters simulated as one batch, 0 simulates a single hair
+	std::string benchmarkName;
+	std::string windVolumePath;
+	HairOptions hairOptions;
+	bool cullingEnabled = true;
+	bool lodEnabled = true;
+	bool geometryShaderEnabled = false;		// Expands the strands in a geometry shader instead of pulling vertices
+	float ribbonWidth = 0.f;				// Root width of the hair ribbons, 0 draws line strips
+	bool curvesEnabled = false;				// Tessellates the strands into Catmull-Rom curves
+	bool selfShadowingEnabled = true;
+	TransparencyMode transparencyMode = TransparencyMode::Opaque;
+	std::string captureDirectory;			// Writes every frame into this directory when set
+	uint32_t captureFrameCount = 0;			// Stops after this many captured frames, 0 captures until the window closes
+	bool headless = false;
+	std::string checkpointPath;				// Restored at startup when it exists, F5 saves the simulation into it
+	std::string bakePath;					// Every simulated frame is compressed into this hair cache when set
+	std::string playbackPath;				// Plays this hair cache back instead of simulating when set
+	for (int i = 1; i < argc; ++i)
+	{
+		const std::string argument = argv[i];
+		if (argument == "--crowd" && i + 1 < argc)
+			parseOption(argument, argv[++i], crowdSize);
+		else if (argument == "--benchmark" && i + 1 < argc)
+			benchmarkName = argv[++i];
+		else if (argument == "--half-precision")
+			hairOptions.halfPrecisionVelocities = true;
+		else if (argument == "--verlet")
+			hairOptions.verletIntegration = true;
+		else if (argument == "--wind-volume" && i + 1 < argc)
+			windVolumePath = argv[++i];
+		else if (argument == "--no-culling")
+			cullingEnabled = false;
+		else if (argument == "--no-lod")
+			lodEnabled = false;
+		else if (argument == "--geometry-shader")
+			geometryShaderEnabled = true;
+		else if (argument == "--ribbons" && i + 1 < argc)
+			parseOption(argument, argv[++i], ribbonWidth);
+		else if (argument == "--curves")
+			curvesEnabled = true;
+		else if (argument == "--particles" && i + 1 < argc)
+			parseOption(argument, argv[++i], hairOptions.particlesPerStrand);
+		else if (argument == "--groom" && i + 1 < argc)
+			hairOptions.groomPath = argv[++i];
+		else if (argument == "--compact-positions")
+			hairOptions.compactPositions = true;
+		else if (argument == "--no-self-shadowing")
+			selfShadowingEnabled = false;
+		else if (argument == "--capture" && i + 1 < argc)
+			captureDirectory = argv[++i];
+		else if (argument == "--capture-frames" && i + 1 < argc)
+			parseOption(argument, argv[++i], captureFrameCount);
+		else if (argument == "--headless")
+			headless = true;
+		else if (argument == "--no-shader-cache")
+			ProgramCache::setEnabled(false);
+		else if (argument == "--checkpoint" && i + 1 < argc)
+			checkpointPath = argv[++i];
+		else if (argument == "--bake" && i + 1 < argc)
+			bakePath = argv[++i];
+		else if (argument == "--play" && i + 1 < argc)
+			playbackPath = argv[++i];
+		else if (argument == "--transparency" && i + 1 < argc)
+		{
+			const std::string mode = argv[++i];
+			if (mode == "weighted")
+				transparencyMode = TransparencyMode::WeightedBlended;
+			else if (mode == "linked-list")
+				transparencyMode = TransparencyMode::LinkedList;
+			else
+				std::cout << "Unknown transparency mode '" << mode << "', available: weighted, linked-list" << std::endl;
+		}
+	}
+
+	// The batch solver runs full precision Heun integration on uniform segments, only the particle count carries over
+	if (crowdSize > 0 && !hairOptions.getDefines().empty())
+	{
+		std::cout << "Crowds are simulated at full precision on procedural strands, --half-precision, --verlet, "
+			"--compact-positions and --groom are ignored with --crowd" << std::endl;
+		HairOptions crowdOptions;
+		crowdOptions.particlesPerStrand = hairOptions.particlesPerStrand;
+		hairOptions = crowdOptions;
+	}
+	// Compact positions are pulled from the storage buffers, the geometry shader reads them as vertex attributes
+	if (hairOptions.compactPositions && geometryShaderEnabled)
+	{
+		std::cout << "The geometry shader can't read compact positions, --geometry-shader is ignored with --compact-positions" << std::endl;
+		geometryShaderEnabled = false;
+	}
+	// Ribbons compute their own edge coverage and don't need multisampling
+	const bool ribbonsEnabled = ribbonWidth > 0.f && crowdSize == 0;
+	curvesEnabled = curvesEnabled && !ribbonsEnabled && crowdSize == 0;
+	// While capturing, multisampling happens in the offscreen target and the window only shows the resolved frame
+	const int sampleCount = ribbonsEnabled ? 1 : 4;
+	const bool captureEnabled = !captureDirectory.empty();
+	if (headless && !captureEnabled)
+		std::cout << "Running headless without --capture, no frames will be visible" << std::endl;
+	auto window = std::make_unique<Window>(1440, 810, "Hair Simulation", captureEnabled ? 1 : sampleCount, !headless);
+	if (!benchmarkName.empty())
+		return HairBenchmark::run(benchmarkName) ? 0 : 1;
+
+	if (ribbonsEnabled)
+	{
+		glEnable(GL_BLEND);
+		glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+	}
+	else
+	{
+		glEnable(GL_MULTISAMPLE);
+	}
 
     // 开启深度测试
 	glEnable(GL_DEPTH_TEST);
@@ -31,35 +195,267 @@ int main()
         cam.setProjectionViewingAngle(100.f);
     }
 
-	Unique<Hair> hair = std::make_unique<Hair>(2000);
-	DrawingShader hairShader("HairVertexShader.glsl", "HairGeometryShader.glsl", "HairFragmentShader.glsl");
+	GpuProfiler profiler;
+	HairShading shading;
+	uint32_t currentAction = 0;		// Action controlled by the arrow keys, picked with the number keys
+	// Ribbons and curves draw every strand, culling and the level of detail it selects only apply to lines
+	const bool linesCulled = cullingEnabled && !ribbonsEnabled && !curvesEnabled;
+	const bool strandLodEnabled = lodEnabled && linesCulled;
+	// A crowd is simulated and drawn by its batch, the single hair is only built without one
+	Unique<Hair> hair;
+	if (crowdSize == 0)
+	{
+		hair = std::make_unique<Hair>(2000, hairOptions);
+		hair->setProfiler(&profiler);
+		hair->setCullingEnabled(linesCulled);
+		hair->setLodEnabled(strandLodEnabled);
+		if (ribbonsEnabled)
+			hair->setRibbonWidth(ribbonWidth);
+		hair->setCurvesEnabled(curvesEnabled);
+		if (!windVolumePath.empty())
+			hair->getWindField().loadFromFile(windVolumePath);
+	}
+	Unique<HairCheckpoint> checkpoint;
+	bool checkpointKeyDown = false;
+	if (!checkpointPath.empty() && crowdSize > 0)
+		std::cout << "Checkpoints only save a single hair, --checkpoint is ignored with --crowd" << std::endl;
+	else if (!checkpointPath.empty())
+	{
+		checkpoint = std::make_unique<HairCheckpoint>(*hair);
+		if (std::filesystem::exists(checkpointPath))
+			HairCheckpoint::restore(*hair, checkpointPath);
+	}
+	Unique<HairCacheWriter> cacheWriter;
+	if (!bakePath.empty() && crowdSize > 0)
+		std::cout << "Only a single hair can be baked, --bake is ignored with --crowd" << std::endl;
+	else if (!bakePath.empty() && hairOptions.compactPositions)
+		std::cout << "Hair caches store full positions, --bake is ignored with --compact-positions" << std::endl;
+	else if (!bakePath.empty())
+		cacheWriter = std::make_unique<HairCacheWriter>(*hair, bakePath);
+	Unique<HairCachePlayer> player;
+	bool pauseKeyDown = false;
+	if (!playbackPath.empty() && crowdSize > 0)
+		std::cout << "Only a single hair can be played back, --play is ignored with --crowd" << std::endl;
+	else if (!playbackPath.empty() && hairOptions.compactPositions)
+		std::cout << "Hair caches store full positions, --play is ignored with --compact-positions" << std::endl;
+	else if (!playbackPath.empty())
+	{
+		player = std::make_unique<HairCachePlayer>(playbackPath);
+		if (player->isValid() && player->getParticlesPerStrand() != hair->getParticlesPerStrand())
+		{
+			std::cout << "The hair cache has " << player->getParticlesPerStrand() << " particles per strand, run it with --particles " <<
+				player->getParticlesPerStrand() << std::endl;
+			player.reset();
+		}
+		else if (!player->isValid())
+		{
+			player.reset();
+		}
+	}
+	const auto createHairShader = [geometryShaderEnabled](const std::vector<std::string>& defines) {
+		if (geometryShaderEnabled)
+			return std::make_unique<DrawingShader>("HairVertexShader.glsl", "HairGeometryShader.glsl", "HairFragmentShader.glsl", defines);
+		return std::make_unique<DrawingShader>("HairStrandVertexShader.glsl", "HairFragmentShader.glsl", defines);
+	};
+	// Every shader pulling the particles of the hair has to match its position storage
+	std::vector<std::string> positionDefines;
+	if (hairOptions.compactPositions)
+		positionDefines.push_back("COMPACT_POSITIONS");
+	std::vector<std::string> hairShaderDefines = positionDefines;
+	Unique<DeepOpacityMap> opacityMap;
+	if (selfShadowingEnabled && crowdSize == 0)
+	{
+		opacityMap = std::make_unique<DeepOpacityMap>(positionDefines);
+		opacityMap->setProfiler(&profiler);
+		hairShaderDefines.push_back("SELF_SHADOWING");
+	}
+	if (ribbonsEnabled)
+		hairShaderDefines.push_back("RIBBONS");
+	if (strandLodEnabled && crowdSize == 0)
+	{
+		hairShaderDefines.push_back("STRAND_LOD");
+		if (transparencyMode == TransparencyMode::Opaque)
+		{
+			// Coverage can't go past one sample per pixel, opaque strands make up for the missing ones with their width
+			hair->setLodWidthCompensation(true);
+			glEnable(GL_SAMPLE_ALPHA_TO_COVERAGE);
+		}
+	}
+	const std::vector<std::string> transparencyDefines = HairTransparency::getDefines(transparencyMode);
+	hairShaderDefines.insert(hairShaderDefines.end(), transparencyDefines.begin(), transparencyDefines.end());
+	Unique<Shader> hairShader;
+	if (ribbonsEnabled)
+		hairShader = std::make_unique<DrawingShader>("HairRibbonVertexShader.glsl", "HairFragmentShader.glsl", hairShaderDefines);
+	else if (curvesEnabled)
+		hairShader = std::make_unique<TessellationShader>("HairStrandVertexShader.glsl", "HairTessControlShader.glsl", "HairTessEvaluationShader.glsl",
+			"HairFragmentShader.glsl", hairShaderDefines);
+	else
+		hairShader = createHairShader(hairShaderDefines);
+
+	std::vector<Unique<Hair>> crowd;
+	Unique<HairBatch> crowdBatch;
+	Unique<DrawingShader> crowdShader;
+	if (crowdSize > 0)
+	{
+		const uint32_t rowLength = static_cast<uint32_t>(std::ceil(std::sqrt(static_cast<float>(crowdSize))));
+		std::vector<const Hair*> crowdHairs;
+		HairOptions crowdOptions = hairOptions;
+		for (uint32_t i = 0; i < crowdSize; ++i)
+		{
+			// Every character grows from the scalp roots sampled for the first one
+			crowd.push_back(std::make_unique<Hair>(2000, crowdOptions));
+			crowdOptions.scalpRoots = crowd.back()->getScalpRoots();
+			crowd.back()->translate(glm::vec3((i % rowLength) * 8.f, 0.f, -(i / rowLength) * 8.f));
+			crowdHairs.push_back(crowd.back().get());
+		}
+
+		crowdBatch = std::make_unique<HairBatch>(crowdHairs);
+		if (!crowdBatch->isValid())
+			return 1;
+		crowdBatch->setProfiler(&profiler);
+		if (!windVolumePath.empty())
+			crowdBatch->getWindField().loadFromFile(windVolumePath);
+		std::vector<std::string> crowdShaderDefines = transparencyDefines;
+		crowdShaderDefines.push_back("BATCHED");
+		crowdShader = createHairShader(crowdShaderDefines);
+	}
+
+	// Hair fragments behind the head fail the early depth test, so the head is drawn before the strands
+	DrawingShader headShader("HeadVertexShader.glsl", "HeadFragmentShader.glsl");
+	std::vector<const Hair*> characters;
+	if (crowd.empty())
+		characters.push_back(hair.get());
+	for (const auto& character : crowd)
+	{
+		characters.push_back(character.get());
+	}
 
 	glViewport(0, 0, window->window_size().x, window->window_size().y);
+	HairTransparency transparency(transparencyMode, window->window_size());
+	transparency.setProfiler(&profiler);
+	Unique<FrameCapture> capture;
+	if (captureEnabled)
+	{
+		capture = std::make_unique<FrameCapture>(window->window_size(), sampleCount, captureDirectory, captureFrameCount);
+		capture->setProfiler(&profiler);
+	}
+	std::cout << "Built " << ProgramCache::getLoadedCount() + ProgramCache::getCompiledCount() << " shader programs in " <<
+		ProgramCache::getBuildTime() << " ms, " << ProgramCache::getLoadedCount() << " loaded from the program cache" << std::endl;
 
-    while (!window->shouldClose())
+    while (!window->shouldClose() && !(capture && capture->isComplete()))
 	{
+		if (capture)
+			capture->beginFrame();
 		glDisable(GL_CULL_FACE);
 		glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
-		if (glm::abs(window->getTime().deltaTime - window->getTime().lastDeltaTime) < 0.1f) {
-            hair->applyPhysics(window->getTime().deltaTime, window->getTime().runningTime);
+		for (int key = GLFW_KEY_0; key <= GLFW_KEY_6; ++key)
+		{
+			if (window->isKeyPressed(key))
+				currentAction = key - GLFW_KEY_0;
+		}
+
+		if (currentAction == 0)
+		{
+			const float step = LIGHT_SPEED * window->getTime().deltaTime;
+			glm::vec3 lightPosition = shading.getLightPosition();
+			lightPosition.x += (window->isKeyPressed(GLFW_KEY_RIGHT) - window->isKeyPressed(GLFW_KEY_LEFT)) * step;
+			lightPosition.y += (window->isKeyPressed(GLFW_KEY_UP) - window->isKeyPressed(GLFW_KEY_DOWN)) * step;
+			shading.setLightPosition(lightPosition);
+		}
+		else if (currentAction == 1 && player)
+		{
+			const float step = HAIR_CACHE_SCRUB_SPEED * window->getTime().deltaTime;
+			player->scrub((window->isKeyPressed(GLFW_KEY_RIGHT) - window->isKeyPressed(GLFW_KEY_LEFT)) * step);
+		}
+		if (player)
+		{
+			const bool keyDown = window->isKeyPressed(GLFW_KEY_ENTER);
+			if (keyDown && !pauseKeyDown)
+				player->setPaused(!player->isPaused());
+			pauseKeyDown = keyDown;
+		}
+
+		if (checkpoint)
+		{
+			const bool keyDown = window->isKeyPressed(GLFW_KEY_F5);
+			if (keyDown && !checkpointKeyDown && !checkpoint->save(*hair, checkpointPath))
+				std::cout << "The previous checkpoint is still being saved" << std::endl;
+			checkpointKeyDown = keyDown;
+			checkpoint->update();
+		}
+
+		if (player) {
+            // Baked frames replace the solver, nothing is simulated
+            player->update(*hair, window->getTime().deltaTime);
+        }
+        else if (glm::abs(window->getTime().deltaTime - window->getTime().lastDeltaTime) < 0.1f) {
+            profiler.begin("Simulation");
+            if (crowdBatch)
+                crowdBatch->applyPhysics(window->getTime().deltaTime, window->getTime().runningTime);
+            else
+                hair->applyPhysics(window->getTime().deltaTime, window->getTime().runningTime);
+            profiler.end("Simulation");
+            if (cacheWriter)
+                cacheWriter->capture(*hair, window->getTime().runningTime);
         }
 
 		glEnable(GL_CULL_FACE);
 
-		hairShader.use();
+		if (!crowdBatch)
+		{
+			hair->cull(cam);
+			hair->expandRibbons(cam, static_cast<float>(window->window_size().y));
+			if (opacityMap)
+				opacityMap->update(*hair, shading.getLightPosition());
+		}
+
+		profiler.begin("Head");
+		headShader.use();
+		headShader.setMat4("projection", cam.getProjection());
+		headShader.setMat4("view", cam.getView());
+		shading.applyLight(headShader);
+		for (const Hair* character : characters)
+		{
+			headShader.setMat4("model", character->getTransformMatrix());
+			headShader.setMat3("normalMatrix", glm::transpose(glm::inverse(glm::mat3(character->getTransformMatrix()))));
+			headShader.setVec3("headColor", character->getHeadColor());
+			character->drawHead();
+		}
+		profiler.end("Head");
+
+		const Shader& activeHairShader = crowdShader ? *crowdShader : *hairShader;
+		activeHairShader.use();
         // 投影变化
-		hairShader.setMat4("projection", cam.getProjection());
+		activeHairShader.setMat4("projection", cam.getProjection());
         // 视角变化
-		hairShader.setMat4("view", cam.getView());
+		activeHairShader.setMat4("view", cam.getView());
 
         // 模型变化
-		hairShader.setMat4("model", hair->getTransformMatrix());
-		hairShader.setUint("particlesPerStrand", PARTICLE_PER_HAIR);
+		if (hair)
+			activeHairShader.setMat4("model", hair->getTransformMatrix());
+		activeHairShader.setUint("particlesPerStrand", crowdBatch ? crowdBatch->getParticlesPerStrand() : hair->getParticlesPerStrand());
+		shading.apply(activeHairShader, cam.getPosition());
+		if (curvesEnabled)
+			activeHairShader.setVec2("viewportSize", glm::vec2(window->window_size()));
+		if (opacityMap && !crowdBatch)
+			opacityMap->apply(activeHairShader);
+
+		transparency.apply(activeHairShader);
 
-		hair->draw();
+		profiler.begin("Hair rendering");
+		transparency.begin();
+		if (crowdBatch)
+			crowdBatch->draw();
+		else
+			hair->draw();
+		profiler.end("Hair rendering");
+		transparency.end();
+		if (capture)
+			capture->endFrame();
 
         window->update();
+        profiler.nextFrame();
 	}
 
 	return 0;